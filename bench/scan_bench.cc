@@ -0,0 +1,94 @@
+// bytes per cycle of every scanner kernel over long runs it has to step
+// over whole, the figures the choice of kernels rests on
+//   scan_bench [megabytes] [rounds]
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "scan.h"
+
+// cycles on x86, nanoseconds elsewhere
+static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+#endif
+}
+
+// a run of filler ended by stop, so the scanner reads all of it
+static std::string makeRun(size_t size, const char* filler, char stop) {
+  std::string run;
+  run.reserve(size + 1);
+  size_t filler_size = std::string(filler).size();
+  for (size_t index = 0; index < size; ++index) {
+    run += filler[index % filler_size];
+  }
+  run += stop;
+  return run;
+}
+
+// fewest ticks of rounds scans, the others were disturbed
+template <typename Scan>
+static double bytesPerTick(const std::string& run, size_t rounds, Scan scan) {
+  const char* begin = run.data();
+  const char* end = run.data() + run.size();
+  uint64_t best = std::numeric_limits<uint64_t>::max();
+  for (size_t round = 0; round < rounds; ++round) {
+    uint64_t start = ticks();
+    const char* found = scan(begin, end);
+    uint64_t spent = ticks() - start;
+    if (found != end - 1) {
+      std::fprintf(stderr, "scanner stopped at %td of %zu\n", found - begin,
+                   run.size());
+      std::exit(1);
+    }
+    best = std::min(best, spent);
+  }
+  return static_cast<double>(run.size()) / static_cast<double>(best);
+}
+
+int main(int argc, char** argv) {
+  size_t megabytes = (argc > 1) ? (std::strtoul(argv[1], nullptr, 10)) : (1);
+  size_t rounds = (argc > 2) ? (std::strtoul(argv[2], nullptr, 10)) : (50);
+  size_t size = std::max<size_t>(megabytes, 1) * 1024 * 1024;
+  rounds = std::max<size_t>(rounds, 1);
+
+  std::string blanks = makeRun(size, " \t  ", 'x');
+  std::string comment = makeRun(size, "a comment * with / no end ", '\n');
+  std::string text = makeRun(size, "a string 'with' no end ", '"');
+
+#if defined(__x86_64__) || defined(__i386__)
+  std::printf("%zu MiB runs, best of %zu, bytes/cycle\n", size >> 20, rounds);
+#else
+  std::printf("%zu MiB runs, best of %zu, bytes/ns\n", size >> 20, rounds);
+#endif
+  std::printf("%-8s %8s %8s %8s\n", "kernel", "blanks", "comment", "string");
+  for (const char* name : {"scalar", "sse2", "avx2"}) {
+    if (!useScanKernels(name)) {
+      std::printf("%-8s %8s %8s %8s\n", name, "-", "-", "-");
+      continue;
+    }
+    double skip = bytesPerTick(blanks, rounds, skipBlanks);
+    double comment_end = bytesPerTick(comment, rounds, findCommentEnd);
+    double special =
+        bytesPerTick(text, rounds, [](const char* begin, const char* end) {
+          return findStringSpecial(begin, end, '"');
+        });
+    std::printf("%-8s %8.2f %8.2f %8.2f\n", name, skip, comment_end, special);
+  }
+  return 0;
+}
@@ -0,0 +1,68 @@
+#include "arena.h"
+
+#include <cstdint>
+
+Arena::Arena(size_t block_size)
+    : block_size_(block_size),
+      blocks_(),
+      large_blocks_(),
+      current_(0),
+      cursor_(nullptr),
+      limit_(nullptr),
+      allocated_(0) {}
+
+void* Arena::allocate(size_t size, size_t align) {
+  allocated_ += size;
+
+  // too big for a regular block, it gets one of its own
+  if (size + align > block_size_) {
+    large_blocks_.emplace_back(
+        std::unique_ptr<char[]>(new char[size + align]), size + align);
+    uintptr_t start =
+        reinterpret_cast<uintptr_t>(large_blocks_.back().first.get());
+    return reinterpret_cast<void*>((start + align - 1) &
+                                   ~static_cast<uintptr_t>(align - 1));
+  }
+
+  uintptr_t start = (reinterpret_cast<uintptr_t>(cursor_) + align - 1) &
+                    ~static_cast<uintptr_t>(align - 1);
+  if ((cursor_ == nullptr) ||
+      (start + size > reinterpret_cast<uintptr_t>(limit_))) {
+    nextBlock();
+    start = reinterpret_cast<uintptr_t>(cursor_);
+  }
+  cursor_ = reinterpret_cast<char*>(start + size);
+  return reinterpret_cast<void*>(start);
+}
+
+void Arena::reset() {
+  large_blocks_.clear();
+  current_ = 0;
+  cursor_ = blocks_.empty() ? (nullptr) : (blocks_[0].get());
+  limit_ = blocks_.empty() ? (nullptr) : (cursor_ + block_size_);
+  allocated_ = 0;
+}
+
+size_t Arena::getBytesAllocated() const { return allocated_; }
+
+size_t Arena::getBytesReserved() const {
+  size_t reserved = blocks_.size() * block_size_;
+  for (const auto& block : large_blocks_) {
+    reserved += block.second;
+  }
+  return reserved;
+}
+
+size_t Arena::getBlockCount() const {
+  return blocks_.size() + large_blocks_.size();
+}
+
+void Arena::nextBlock() {
+  // reuse a block kept by reset before making a new one
+  if ((cursor_ == nullptr) || (current_ + 1 >= blocks_.size())) {
+    blocks_.emplace_back(new char[block_size_]);
+  }
+  current_ = (cursor_ == nullptr) ? (0) : (current_ + 1);
+  cursor_ = blocks_[current_].get();
+  limit_ = cursor_ + block_size_;
+}
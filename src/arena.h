@@ -0,0 +1,92 @@
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifndef SRC_ARENA_H_
+#define SRC_ARENA_H_
+
+/*
+ Arena representing bump-allocated memory released all at once, one arena
+ serves one translation unit and is reset for the next
+ block_size_ - Size of a regular block
+ blocks_ - Regular blocks, kept across resets
+ large_blocks_ - Blocks for allocations bigger than a regular block
+ current_ - Index in blocks_ of the block being bumped
+ cursor_, limit_ - Free bytes of the current block
+ allocated_ - Bytes handed out since the last reset
+ */
+class Arena {
+ public:
+  explicit Arena(size_t block_size = 64 * 1024);
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+ public:
+  void* allocate(size_t size, size_t align);
+  // forget every allocation, regular blocks are kept for reuse
+  void reset();
+
+  size_t getBytesAllocated() const;
+  size_t getBytesReserved() const;
+  size_t getBlockCount() const;
+
+ private:
+  void nextBlock();
+
+ private:
+  size_t block_size_;
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  std::vector<std::pair<std::unique_ptr<char[]>, size_t>> large_blocks_;
+  size_t current_;
+  char* cursor_;
+  char* limit_;
+  size_t allocated_;
+};
+
+/*
+ ArenaAllocator representing an STL allocator drawing from an Arena,
+ deallocation is left to Arena::reset
+ arena_ - Arena the memory comes from
+ */
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+
+  explicit ArenaAllocator(Arena& arena) : arena_(&arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other)
+      : arena_(other.getArena()) {}
+
+ public:
+  T* allocate(size_t count) {
+    return static_cast<T*>(arena_->allocate(count * sizeof(T), alignof(T)));
+  }
+  void deallocate(T*, size_t) {}
+
+  Arena* getArena() const { return arena_; }
+
+ private:
+  Arena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs) {
+  return lhs.getArena() == rhs.getArena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs) {
+  return lhs.getArena() != rhs.getArena();
+}
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+using ArenaString =
+    std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+#endif  // SRC_ARENA_H_
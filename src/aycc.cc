@@ -1,105 +1,453 @@
 #include "aycc.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 
+#include "interner.h"
 #include "lexer.h"
-#include "para_init.h"
+#include "output_buffer.h"
 #include "preproc.h"
+#include "thread_pool.h"
 
-Aycc::Aycc(int argc, char** argv) : need_lexer_(false), files_() {
+Aycc::Aycc(int argc, char** argv)
+    : dump_(TokenDump::NONE),
+      need_stats_(false),
+      jobs_(1),
+      parallel_lex_size_(0),
+      lex_pool_(),
+      search_(0),
+      error_limit_(0),
+      need_depfile_(false),
+      depfile_(),
+      files_(),
+      errors_(),
+      own_includes_(new IncludeCache()),
+      includes_(*own_includes_),
+      token_cache_(),
+      include_counts_(),
+      out_(std::cout),
+      err_(std::cerr),
+      out_fd_(STDOUT_FILENO),
+      dump_path_(),
+      log_(&out_),
+      output_(),
+      output_stream_(nullptr),
+      manifest_path_(),
+      manifest_(),
+      manifest_options_(0),
+      output_mutex_(),
+      next_output_(0) {
   ParaInit para_init(argc, argv);
-  need_lexer_ = para_init.needLexer();
+  setOptions(para_init);
+}
+
+Aycc::Aycc(ParaInit& para_init, std::ostream& out, std::ostream& err,
+           IncludeCache& includes, size_t max_jobs)
+    : dump_(TokenDump::NONE),
+      need_stats_(false),
+      jobs_(1),
+      parallel_lex_size_(0),
+      lex_pool_(),
+      search_(0),
+      error_limit_(0),
+      need_depfile_(false),
+      depfile_(),
+      files_(),
+      errors_(),
+      own_includes_(),
+      includes_(includes),
+      token_cache_(),
+      include_counts_(),
+      out_(out),
+      err_(err),
+      out_fd_(-1),
+      dump_path_(),
+      log_(&out_),
+      output_(),
+      output_stream_(nullptr),
+      manifest_path_(),
+      manifest_(),
+      manifest_options_(0),
+      output_mutex_(),
+      next_output_(0) {
+  setOptions(para_init);
+  jobs_ = std::max<size_t>(std::min(jobs_, max_jobs), 1);
+}
+
+void Aycc::setOptions(ParaInit& para_init) {
+  std::string dump = para_init.getTokenDump();
+  if ((!dump.empty()) && (!TokenWriter::findFormat(dump, dump_))) {
+    throw CompilerError(DiagID::UNKNOWN_DUMP_FORMAT, dump);
+  }
+  dump_path_ = para_init.getDumpFile();
+  need_stats_ = para_init.needStats();
+  jobs_ = para_init.getJobs();
+  parallel_lex_size_ = para_init.getParallelLexSize();
   files_ = para_init.getFiles();
+  std::string token_cache_dir = para_init.getTokenCacheDir();
+  if (!token_cache_dir.empty()) {
+    token_cache_.reset(new TokenCache(token_cache_dir));
+  }
+  manifest_path_ = para_init.getManifestPath();
+  depfile_ = para_init.getDepfilePath();
+  need_depfile_ = (para_init.needDepfile()) || (!depfile_.empty());
+  search_ = HeaderSearch::instance().addSearchList(
+      para_init.getIncludeDirs(), para_init.getSystemIncludeDirs());
+  manifest_options_ = BuildManifest::hashOptions(search_);
+  error_limit_ = para_init.getErrorLimit();
 }
 
 bool Aycc::run() {
-  // proc every .c to produce .o
+  if (!manifest_path_.empty()) {
+    manifest_.reset(new BuildManifest(manifest_path_));
+  }
+  int dump_fd = -1;
+  if ((dump_ != TokenDump::NONE) && (!dump_path_.empty())) {
+    dump_fd = open(dump_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                   0644);
+    if (dump_fd < 0) {
+      throw CompilerError(DiagID::CANT_WRITE_DUMP_FILE, dump_path_);
+    }
+    output_.reset(new OutputBuffer(dump_fd));
+  } else if (out_fd_ >= 0) {
+    // written around the stream from here on
+    out_.flush();
+    output_.reset(new OutputBuffer(out_fd_));
+  } else {
+    output_.reset(new OutputBuffer(out_));
+  }
+  output_stream_.rdbuf(output_.get());
+  // a dump for tools on the standard output is kept clear of the rest
+  log_ = ((isToolDump()) && (dump_fd < 0)) ? (&err_) : (&out_);
+
+  std::vector<FileResult> results(files_.size());
+  if (parallel_lex_size_ > 0) {
+    lex_pool_.reset(new ThreadPool(jobs_));
+  }
+  {
+    ThreadPool pool(std::min(jobs_, files_.size()));
+    // one arena per worker, reset after every file it compiles
+    std::vector<std::unique_ptr<Arena>> arenas;
+    for (size_t worker = 0; worker < pool.size(); ++worker) {
+      arenas.emplace_back(new Arena());
+    }
+
+    // proc every .c to produce .o
+    for (size_t index : scheduleFiles()) {
+      pool.submit([this, index, &arenas, &results](size_t worker) {
+        compileFile(index, *arenas[worker], results);
+      });
+    }
+    pool.wait();
+  }
+  bool written = output_->flush();
+  if (dump_fd >= 0) {
+    written = (close(dump_fd) == 0) && (written);
+    if (!written) {
+      errors_.push_back(
+          CompilerError(DiagID::CANT_WRITE_DUMP_FILE, dump_path_));
+    }
+  }
+  if (need_stats_) {
+    *log_ << "[stats] include cache: " << include_counts_.hits_
+          << " hits, " << include_counts_.misses_ << " misses, "
+          << include_counts_.loads_ << " loaded from disk" << std::endl;
+  }
+
+  if ((need_stats_) && (manifest_)) {
+    size_t reused = std::count_if(
+        results.begin(), results.end(),
+        [](const FileResult& result) { return result.reused_; });
+    *log_ << "[stats] incremental: " << reused << " of " << results.size()
+          << " files up to date" << std::endl;
+  }
+
+  // merged in file order, whatever order the files were compiled in
   std::vector<std::string> objs;
-  for (const auto& file : files_) {
-    std::string obj = procFile(file);
-    if (obj.compare("")) {
-      objs.push_back(obj);
+  for (auto& result : results) {
+    if (result.obj_.compare("")) {
+      objs.push_back(result.obj_);
+    }
+    errors_.insert(errors_.end(), result.errors_.begin(),
+                   result.errors_.end());
+  }
+
+  writeDependencies(results);
+  if (manifest_) {
+    for (auto& result : results) {
+      if ((result.obj_.compare("")) && (!result.record_.sources_.empty())) {
+        manifest_->update(result.obj_, std::move(result.record_));
+      }
+    }
+    if (!manifest_->save()) {
+      errors_.push_back(
+          CompilerError(DiagID::CANT_WRITE_MANIFEST, manifest_path_, true));
     }
   }
 
   showErrors();
 
   if (objs.size() < files_.size()) {
-    throw CompilerError(
-        "not enough number of properly processed files to link");
+    throw CompilerError(DiagID::NOT_ENOUGH_FILES);
   }
 
   return true;
 }
 
-std::string Aycc::procFile(const std::string& file) {
+// biggest files first, so no worker is left with a big one at the end
+std::vector<size_t> Aycc::scheduleFiles() {
+  std::vector<std::pair<off_t, size_t>> sizes;
+  for (size_t index = 0; index < files_.size(); ++index) {
+    struct stat st;
+    off_t size = (stat(files_[index].c_str(), &st) == 0) ? (st.st_size) : (0);
+    sizes.push_back({size, index});
+  }
+  std::stable_sort(sizes.begin(), sizes.end(),
+                   [](const std::pair<off_t, size_t>& lhs,
+                      const std::pair<off_t, size_t>& rhs) {
+                     return lhs.first > rhs.first;
+                   });
+
+  std::vector<size_t> order;
+  for (const auto& size : sizes) {
+    order.push_back(size.second);
+  }
+  return order;
+}
+
+void Aycc::compileFile(size_t index, Arena& arena,
+                       std::vector<FileResult>& results) {
+  FileResult& result = results[index];
+  if (reuseObject(files_[index], result)) {
+    flushOutput(index, results);
+    return;
+  }
+
+  // the file next in order prints as it goes, the others hold their output
+  // until the files before them are printed
+  bool next;
+  {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    next = (index == next_output_);
+  }
+  CompileUnit unit{arena, result.errors_,
+                   (next) ? (output_stream_) : (result.out_), dump_,
+                   parallel_lex_size_, lex_pool_.get(), &includes_,
+                   token_cache_.get(), &include_counts_, search_,
+                   error_limit_};
+  // a source stamped from here on may change after it is read
+  result.record_.options_ = manifest_options_;
+  result.record_.built_ = BuildManifest::now();
+  std::vector<FileID> sources;
+  try {
+    result.obj_ = procFile(files_[index], unit, sources);
+    if ((result.obj_.compare("")) && (!sources.empty())) {
+      for (FileID source : sources) {
+        result.deps_.push_back(SourceManager::instance().getFileName(source));
+      }
+      if (manifest_) {
+        result.record_.sources_ = BuildManifest::describe(sources);
+      }
+    }
+  } catch (const CompilerError& e) {
+    result.errors_.push_back(e);
+  } catch (const std::exception& e) {
+    // anything else fails the file alone, an exception leaving the task
+    // would end the whole run
+    result.obj_.clear();
+    result.deps_.clear();
+    result.record_.sources_.clear();
+    result.errors_.push_back(CompilerError(
+        DiagID::INTERNAL_ERROR, files_[index] + ": " + e.what()));
+  }
+  if (need_stats_) {
+    // a dump for tools to read is kept clear of them
+    showStats(files_[index], unit,
+              (isToolDump()) ? (result.stats_) : (unit.out_));
+  }
+  // everything of the file goes at once, the blocks serve the next one
+  arena.reset();
+
+  flushOutput(index, results);
+}
+
+// print the output of every file compiled so far without a gap before it
+void Aycc::flushOutput(size_t index, std::vector<FileResult>& results) {
+  std::lock_guard<std::mutex> lock(output_mutex_);
+  results[index].done_ = true;
+  while ((next_output_ < results.size()) && (results[next_output_].done_)) {
+    FileResult& result = results[next_output_];
+    std::string held = result.out_.str();
+    output_->append(held);
+    result.out_.str(std::string());
+    if (result.stats_.tellp() > 0) {
+      *log_ << result.stats_.str() << std::flush;
+      result.stats_.str(std::string());
+    }
+    ++next_output_;
+  }
+}
+
+// the object of an earlier run is taken as is when no source of it changed,
+// unless its tokens are asked for
+bool Aycc::reuseObject(const std::string& file, FileResult& result) {
+  std::string obj = file + ".o";
+  if ((!manifest_) || (dump_ != TokenDump::NONE) ||
+      (!manifest_->check(obj, manifest_options_, result.record_))) {
+    result.record_.sources_.clear();
+    return false;
+  }
+
+  result.obj_ = obj;
+  result.reused_ = true;
+  for (const auto& source : result.record_.sources_) {
+    result.deps_.push_back(source.path_);
+  }
+  return true;
+}
+
+// spaces, # and $ are special to make
+static std::string escapeMake(const std::string& path) {
+  std::string escaped;
+  for (char c : path) {
+    if ((c == ' ') || (c == '#')) {
+      escaped += '\\';
+    } else if (c == '$') {
+      escaped += '$';
+    }
+    escaped += c;
+  }
+  return escaped;
+}
+
+// one make rule for every object, all in the -MF file or each in a .d file
+// next to its object
+void Aycc::writeDependencies(const std::vector<FileResult>& results) {
+  if (!need_depfile_) {
+    return;
+  }
+
+  std::ostringstream rules;
+  for (const auto& result : results) {
+    if ((!result.obj_.compare("")) || (result.deps_.empty())) {
+      continue;
+    }
+    std::ostringstream rule;
+    rule << escapeMake(result.obj_) << ":";
+    for (const auto& dep : result.deps_) {
+      rule << " \\\n  " << escapeMake(dep);
+    }
+    rule << "\n";
+
+    if (!depfile_.empty()) {
+      rules << rule.str();
+      continue;
+    }
+    std::string path = result.obj_.substr(0, result.obj_.size() - 2) + ".d";
+    std::ofstream out(path, std::ios::trunc);
+    out << rule.str();
+    if (!out) {
+      errors_.push_back(CompilerError(DiagID::CANT_WRITE_DEPS, path));
+    }
+  }
+
+  if (!depfile_.empty()) {
+    std::ofstream out(depfile_, std::ios::trunc);
+    out << rules.str();
+    if (!out) {
+      errors_.push_back(CompilerError(DiagID::CANT_WRITE_DEPS, depfile_));
+    }
+  }
+}
+
+std::string Aycc::procFile(const std::string& file, CompileUnit& unit,
+                           std::vector<FileID>& sources) {
   if (file.size() < 2) {
-    errors_.push_back(CompilerError("unknown file type [" + file + "]"));
+    unit.errors_.push_back(CompilerError(DiagID::UNKNOWN_FILE_TYPE, file));
     return "";
   }
 
   if (!file.substr(file.size() - 2).compare(".c")) {
-    return procCFile(file);
+    return procCFile(file, unit, sources);
   }
 
   if (!file.substr(file.size() - 2).compare(".o")) {
     return file;
   }
 
-  errors_.push_back(CompilerError("unknown file type [" + file + "]"));
+  unit.errors_.push_back(CompilerError(DiagID::UNKNOWN_FILE_TYPE, file));
   return "";
 }
 
-std::string Aycc::procCFile(const std::string& file) {
-  std::vector<char> buffer;
-  if (!readCFile(file, buffer)) {
-    errors_.push_back(CompilerError("file can't open [" + file + "]"));
+std::string Aycc::procCFile(const std::string& file, CompileUnit& unit,
+                            std::vector<FileID>& sources) {
+  FileID id;
+  if (!readCFile(file, id)) {
+    unit.errors_.push_back(CompilerError(DiagID::CANT_OPEN_FILE, file));
     return "";
   }
 
-  std::vector<Token> tokens;
-  Lexer lexer(buffer, file, need_lexer_);
-  lexer.tokenize(tokens, errors_);
-  if (!isErrorsOk()) {
-    return "";
+  // nothing after preprocessing pulls tokens yet, drain them
+  PreProc preproc(id, unit);
+  PreProc::Segment segment;
+  while (preproc.next(segment)) {
   }
-
-  PreProc preproc(file, need_lexer_);
-  preproc.retokenize(tokens, errors_);
-  if (!isErrorsOk()) {
+  if (unit.getErrorRoom() == 0) {
+    unit.errors_.push_back(CompilerError(DiagID::TOO_MANY_ERRORS, file));
+  }
+  if (!isErrorsOk(unit.errors_)) {
     return "";
   }
+  sources.push_back(id);
+  sources.insert(sources.end(), preproc.getIncludedFiles().begin(),
+                 preproc.getIncludedFiles().end());
 
   return file + ".o";
 }
 
-bool Aycc::readCFile(const std::string& file, std::vector<char>& buffer) {
-  std::ifstream ifst(file);
-  if (!ifst.is_open()) {
-    return false;
-  }
+bool Aycc::readCFile(const std::string& file, FileID& id) {
+  return SourceManager::instance().loadFile(file, id);
+}
 
-  for (char c; ifst.get(c); buffer.push_back(c)) {
+void Aycc::showErrors() {
+  OutputBuffer out(*log_);
+  std::string text;
+  for (const auto& ce : errors_) {
+    text.clear();
+    ce.render(text);
+    text += '\n';
+    out.append(text);
   }
+}
 
-  return true;
+void Aycc::showTokens(const TokenStream& tokens) {
+  for (size_t index = 0; index < tokens.size(); ++index) {
+    out_ << tokens[index] << std::endl;
+  }
 }
 
-void Aycc::showErrors() {
-  std::for_each(errors_.begin(), errors_.end(),
-                [](const CompilerError& ce) { std::cout << ce << std::endl; });
+void Aycc::showStats(const std::string& file, CompileUnit& unit,
+                     std::ostream& out) {
+  out << "[stats] " << file << ": " << unit.arena_.getBytesAllocated()
+      << " bytes allocated, " << unit.arena_.getBytesReserved()
+      << " bytes reserved in " << unit.arena_.getBlockCount()
+      << " blocks, " << Interner::instance().size()
+      << " symbols interned" << std::endl;
 }
 
-void Aycc::showTokens(const std::vector<Token>& tokens) {
-  std::for_each(tokens.begin(), tokens.end(),
-                [](const Token& tk) { std::cout << tk << std::endl; });
+bool Aycc::isToolDump() const {
+  return (dump_ == TokenDump::JSONL) || (dump_ == TokenDump::BIN);
 }
 
-bool Aycc::isErrorsOk() {
-  for (const auto& er : errors_) {
+bool Aycc::isErrorsOk(const std::vector<CompilerError>& errors) {
+  for (const auto& er : errors) {
     if (!er.isWarning()) {
       return false;
     }
@@ -1,8 +1,22 @@
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <string>
 #include <vector>
 
+#include "arena.h"
+#include "build_manifest.h"
+#include "compile_unit.h"
 #include "errors.h"
-#include "tokens.h"
+#include "header_search.h"
+#include "include_cache.h"
+#include "output_buffer.h"
+#include "para_init.h"
+#include "source_manager.h"
+#include "thread_pool.h"
+#include "token_cache.h"
+#include "token_stream.h"
 
 #ifndef SRC_AYCC_H_
 #define SRC_AYCC_H_
@@ -10,21 +24,100 @@
 class Aycc {
  public:
   Aycc(int argc, char** argv);
+  // a request to the compile server: output goes to out and err, headers
+  // are shared with earlier requests through includes, and at most max_jobs
+  // files are compiled at once, the share of the machine of the request
+  Aycc(ParaInit& para_init, std::ostream& out, std::ostream& err,
+       IncludeCache& includes, size_t max_jobs);
 
  public:
   bool run();
 
  private:
-  std::string procFile(const std::string& file);
-  std::string procCFile(const std::string& file);
-  bool readCFile(const std::string& file, std::vector<char>& buffer);
+  /*
+   FileResult representing the outcome of compiling one input file
+   obj_ - Object file produced, empty if the file failed
+   errors_ - Errors found in the file
+   out_ - Debug output of the file held until the files before it are
+          printed, empty if it printed as it went
+   stats_ - Statistics of the file, printed to the log after it when the
+            output is a dump for tools to read
+   deps_ - The file and every file it includes, for its make rule
+   record_ - How obj_ was built for the BuildManifest, deps_ as hashed
+             in its sources_, none if it isn't recorded
+   reused_ - True if the object of an earlier run is up to date
+   done_ - True once the file is compiled
+   */
+  struct FileResult {
+    std::string obj_;
+    std::vector<CompilerError> errors_;
+    std::ostringstream out_;
+    std::ostringstream stats_;
+    std::vector<std::string> deps_;
+    BuildManifest::Record record_;
+    bool reused_ = false;
+    bool done_ = false;
+  };
+
+  void setOptions(ParaInit& para_init);
+  std::vector<size_t> scheduleFiles();
+  void compileFile(size_t index, Arena& arena,
+                   std::vector<FileResult>& results);
+  void flushOutput(size_t index, std::vector<FileResult>& results);
+  bool reuseObject(const std::string& file, FileResult& result);
+  void writeDependencies(const std::vector<FileResult>& results);
+  std::string procFile(const std::string& file, CompileUnit& unit,
+                       std::vector<FileID>& sources);
+  std::string procCFile(const std::string& file, CompileUnit& unit,
+                        std::vector<FileID>& sources);
+  bool readCFile(const std::string& file, FileID& id);
   void showErrors();
-  void showTokens(const std::vector<Token>& tokens);
-  bool isErrorsOk();
+  void showTokens(const TokenStream& tokens);
+  void showStats(const std::string& file, CompileUnit& unit,
+                 std::ostream& out);
+  // true if tokens are dumped in a format for tools rather than people
+  bool isToolDump() const;
+  bool isErrorsOk(const std::vector<CompilerError>& errors);
 
  private:
-  bool need_lexer_;
+  TokenDump dump_;
+  bool need_stats_;
+  size_t jobs_;
+  size_t parallel_lex_size_;
+  // big files are lexed in chunks on it, jobs_ threads for the whole run
+  std::unique_ptr<ThreadPool> lex_pool_;
+  SearchID search_;
+  size_t error_limit_;
+  bool need_depfile_;
+  std::string depfile_;
   std::vector<std::string> files_;
+  // errors outlive the file they are found in, so they stay on the heap
   std::vector<CompilerError> errors_;
+  // headers are lexed once and shared by every file of the run, or of every
+  // request to the server
+  std::unique_ptr<IncludeCache> own_includes_;
+  IncludeCache& includes_;
+  // headers lexed by earlier runs, nullptr if not used
+  std::unique_ptr<TokenCache> token_cache_;
+  // how includes_ served this run alone
+  IncludeCounts include_counts_;
+  std::ostream& out_;
+  std::ostream& err_;
+  // descriptor of out_ when it is the standard output, -1 otherwise
+  int out_fd_;
+  // tokens go there instead of out_ when not empty
+  std::string dump_path_;
+  // errors and statistics, err_ when a dump for tools takes out_
+  std::ostream* log_;
+  // output of the files in file order, written a block at a time
+  std::unique_ptr<OutputBuffer> output_;
+  std::ostream output_stream_;
+  // sources of the objects of earlier runs, nullptr unless incremental
+  std::string manifest_path_;
+  std::unique_ptr<BuildManifest> manifest_;
+  uint64_t manifest_options_;
+  // output of files before next_output_ has been printed
+  std::mutex output_mutex_;
+  size_t next_output_;
 };
 #endif  // SRC_AYCC_H_
@@ -0,0 +1,200 @@
+#include "build_manifest.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+
+#include "lexer.h"
+#include "source_buffer.h"
+
+// first line of a manifest, bumped whenever the layout below changes
+static const char manifest_header[] = "AYCC manifest 2";
+
+// FNV-1a
+static uint64_t hashBytes(const char* data, size_t size,
+                          uint64_t hash = 14695981039346656037ull) {
+  for (size_t index = 0; index < size; ++index) {
+    hash = (hash ^ static_cast<unsigned char>(data[index])) *
+           1099511628211ull;
+  }
+  return hash;
+}
+
+static bool isSameTime(const struct timespec& lhs,
+                       const struct timespec& rhs) {
+  return (lhs.tv_sec == rhs.tv_sec) && (lhs.tv_nsec == rhs.tv_nsec);
+}
+
+static bool isBefore(const struct timespec& lhs, const struct timespec& rhs) {
+  return (lhs.tv_sec < rhs.tv_sec) ||
+         ((lhs.tv_sec == rhs.tv_sec) && (lhs.tv_nsec < rhs.tv_nsec));
+}
+
+BuildManifest::BuildManifest(const std::string& path)
+    : path_(path), records_() {
+  load();
+}
+
+bool BuildManifest::check(const std::string& obj, uint64_t options,
+                          Record& record) const {
+  auto found = records_.find(obj);
+  if ((found == records_.end()) || (found->second.options_ != options)) {
+    return false;
+  }
+
+  record = found->second;
+  SourceManager& manager = SourceManager::instance();
+  for (auto& source : record.sources_) {
+    struct stat st;
+    if (stat(source.path_.c_str(), &st) != 0) {
+      return false;
+    }
+    // one stamped once the build started may have been written again in
+    // the same tick after it was read, its time proves nothing
+    if ((source.size_ == static_cast<uint64_t>(st.st_size)) &&
+        (isSameTime(source.mtime_, st.st_mtim)) &&
+        (isBefore(source.mtime_, record.built_))) {
+      continue;
+    }
+
+    // touched, it may still hold the same bytes
+    FileID id;
+    if (!manager.loadFile(source.path_, id)) {
+      return false;
+    }
+    const SourceBuffer& buffer = manager.getBuffer(id);
+    if ((source.size_ != buffer.size()) ||
+        (source.hash_ != hashBytes(buffer.begin(), buffer.size()))) {
+      return false;
+    }
+    source.mtime_ = manager.getModifiedTime(id);
+  }
+  return true;
+}
+
+void BuildManifest::update(const std::string& obj, Record record) {
+  records_[obj] = std::move(record);
+}
+
+bool BuildManifest::save() const {
+  std::ostringstream text;
+  text << manifest_header << "\n";
+  for (const auto& record : records_) {
+    // one path a line
+    if (record.first.find('\n') != std::string::npos) {
+      continue;
+    }
+    text << "obj " << record.second.sources_.size() << " " << std::hex
+         << record.second.options_ << std::dec << " "
+         << record.second.built_.tv_sec << " " << record.second.built_.tv_nsec
+         << " " << record.first << "\n";
+    for (const auto& source : record.second.sources_) {
+      text << std::hex << source.hash_ << std::dec << " " << source.size_
+           << " " << source.mtime_.tv_sec << " " << source.mtime_.tv_nsec
+           << " " << source.path_ << "\n";
+    }
+  }
+
+  // written aside and renamed, so a run stopped halfway leaves the old one
+  std::ostringstream temp;
+  temp << path_ << "." << getpid() << ".tmp";
+  {
+    std::ofstream out(temp.str(), std::ios::trunc);
+    out << text.str();
+    if (!out) {
+      out.close();
+      std::remove(temp.str().c_str());
+      return false;
+    }
+  }
+  if (std::rename(temp.str().c_str(), path_.c_str()) != 0) {
+    std::remove(temp.str().c_str());
+    return false;
+  }
+  return true;
+}
+
+std::vector<BuildManifest::Source> BuildManifest::describe(
+    const std::vector<FileID>& files) {
+  const SourceManager& manager = SourceManager::instance();
+  std::vector<Source> sources;
+  for (FileID file : files) {
+    const SourceBuffer& buffer = manager.getBuffer(file);
+    sources.push_back({manager.getFileName(file), buffer.size(),
+                       manager.getModifiedTime(file),
+                       hashBytes(buffer.begin(), buffer.size())});
+  }
+  return sources;
+}
+
+uint64_t BuildManifest::hashOptions(SearchID search) {
+  uint32_t version = Lexer::version;
+  uint64_t hash =
+      hashBytes(reinterpret_cast<const char*>(&version), sizeof(version));
+  for (const auto& dir : HeaderSearch::instance().getSearchList(search)) {
+    hash = hashBytes(dir.c_str(), dir.size() + 1, hash);
+  }
+  return hash;
+}
+
+struct timespec BuildManifest::now() {
+  struct timespec time;
+  // the coarse clock is the one file times come from, a finer one may run
+  // ahead of the time of a file written after it was read
+#ifdef CLOCK_REALTIME_COARSE
+  clock_gettime(CLOCK_REALTIME_COARSE, &time);
+#else
+  clock_gettime(CLOCK_REALTIME, &time);
+#endif
+  return time;
+}
+
+void BuildManifest::load() {
+  std::ifstream in(path_);
+  std::string line;
+  if ((!std::getline(in, line)) || (line != manifest_header)) {
+    return;
+  }
+
+  // a truncated or damaged manifest rebuilds everything
+  while (std::getline(in, line)) {
+    std::istringstream obj_line(line);
+    std::string tag;
+    size_t count;
+    Record record;
+    if ((!(obj_line >> tag >> count >> std::hex >> record.options_ >>
+           std::dec >> record.built_.tv_sec >> record.built_.tv_nsec)) ||
+        (tag != "obj") || (obj_line.get() != ' ')) {
+      records_.clear();
+      return;
+    }
+    std::string obj;
+    std::getline(obj_line, obj);
+
+    std::vector<Source>& sources = record.sources_;
+    for (size_t index = 0; index < count; ++index) {
+      Source source;
+      if (!std::getline(in, line)) {
+        break;
+      }
+      std::istringstream source_line(line);
+      if ((!(source_line >> std::hex >> source.hash_ >> std::dec >>
+             source.size_ >> source.mtime_.tv_sec >>
+             source.mtime_.tv_nsec)) ||
+          (source_line.get() != ' ')) {
+        break;
+      }
+      std::getline(source_line, source.path_);
+      sources.push_back(std::move(source));
+    }
+    if (sources.size() != count) {
+      records_.clear();
+      return;
+    }
+    records_[obj] = std::move(record);
+  }
+}
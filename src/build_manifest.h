@@ -0,0 +1,75 @@
+#include <time.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "header_search.h"
+#include "source_manager.h"
+
+#ifndef SRC_BUILD_MANIFEST_H_
+#define SRC_BUILD_MANIFEST_H_
+
+/*
+ BuildManifest representing what every object was built from on earlier
+ runs, so a file whose sources are all unchanged isn't compiled again. A
+ source whose size and time are unchanged is taken as is, any other is
+ hashed and compared. The record alone decides, nothing is read back from
+ the object, it must only have been built with the same options
+ path_ - File the manifest is read from and saved to, a text file
+ records_ - How every object was built
+ */
+class BuildManifest {
+ public:
+  /*
+   Source representing one file an object was built from
+   path_ - Path of the file
+   size_, mtime_ - Size and modification time of the file when hashed
+   hash_ - Hash of the content of the file
+   */
+  struct Source {
+    std::string path_;
+    uint64_t size_;
+    struct timespec mtime_;
+    uint64_t hash_;
+  };
+
+  /*
+   Record representing how one object was built
+   options_ - Hash of the options the sources were compiled with
+   built_ - Time its build started, sources stamped since are hashed
+   sources_ - Files it was built from, its .c file first
+   */
+  struct Record {
+    uint64_t options_;
+    struct timespec built_;
+    std::vector<Source> sources_;
+  };
+
+ public:
+  // a manifest missing or written by another build of the compiler is empty
+  explicit BuildManifest(const std::string& path);
+
+ public:
+  // record of obj if obj is up to date with it under options, the times of
+  // the sources only touched refreshed
+  bool check(const std::string& obj, uint64_t options, Record& record) const;
+  void update(const std::string& obj, Record record);
+  bool save() const;
+
+  // sources as the SourceManager loaded them
+  static std::vector<Source> describe(const std::vector<FileID>& files);
+  // hash of the options that change what the sources compile to
+  static uint64_t hashOptions(SearchID search);
+  // time on the clock files are stamped with
+  static struct timespec now();
+
+ private:
+  void load();
+
+ private:
+  std::string path_;
+  std::unordered_map<std::string, Record> records_;
+};
+#endif  // SRC_BUILD_MANIFEST_H_
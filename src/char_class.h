@@ -0,0 +1,89 @@
+#include <cstddef>
+#include <cstdint>
+
+#ifndef SRC_CHAR_CLASS_H_
+#define SRC_CHAR_CLASS_H_
+
+// classes of a byte, combined as bit flags in char_class_table
+constexpr uint8_t CHAR_BLANK = 0x01;
+constexpr uint8_t CHAR_NEWLINE = 0x02;
+constexpr uint8_t CHAR_DIGIT = 0x04;
+constexpr uint8_t CHAR_OCT_DIGIT = 0x08;
+constexpr uint8_t CHAR_HEX_DIGIT = 0x10;
+constexpr uint8_t CHAR_IDENT_START = 0x20;
+constexpr uint8_t CHAR_IDENT = 0x40;
+
+/*
+ CharClassTable representing the classes of all 256 byte values
+ class_ - Flags of every byte
+ */
+struct CharClassTable {
+  uint8_t class_[256];
+};
+
+constexpr CharClassTable buildCharClassTable() {
+  CharClassTable table{};
+  table.class_[static_cast<unsigned char>(' ')] |= CHAR_BLANK;
+  table.class_[static_cast<unsigned char>('\t')] |= CHAR_BLANK;
+  table.class_[static_cast<unsigned char>('\n')] |= CHAR_NEWLINE;
+  for (int c = '0'; c <= '9'; ++c) {
+    table.class_[c] |= CHAR_DIGIT | CHAR_HEX_DIGIT | CHAR_IDENT;
+  }
+  for (int c = '0'; c <= '7'; ++c) {
+    table.class_[c] |= CHAR_OCT_DIGIT;
+  }
+  for (int c = 'a'; c <= 'z'; ++c) {
+    table.class_[c] |= CHAR_IDENT_START | CHAR_IDENT;
+    table.class_[c - 'a' + 'A'] |= CHAR_IDENT_START | CHAR_IDENT;
+  }
+  for (int c = 'a'; c <= 'f'; ++c) {
+    table.class_[c] |= CHAR_HEX_DIGIT;
+    table.class_[c - 'a' + 'A'] |= CHAR_HEX_DIGIT;
+  }
+  table.class_[static_cast<unsigned char>('_')] |=
+      CHAR_IDENT_START | CHAR_IDENT;
+  return table;
+}
+
+constexpr CharClassTable char_class_table = buildCharClassTable();
+
+constexpr bool isCharClass(char c, uint8_t cls) {
+  return (char_class_table.class_[static_cast<unsigned char>(c)] & cls) != 0;
+}
+
+constexpr bool isBlankChar(char c) { return isCharClass(c, CHAR_BLANK); }
+
+constexpr bool isDigitChar(char c) { return isCharClass(c, CHAR_DIGIT); }
+
+constexpr bool isOctDigitChar(char c) { return isCharClass(c, CHAR_OCT_DIGIT); }
+
+constexpr bool isHexDigitChar(char c) { return isCharClass(c, CHAR_HEX_DIGIT); }
+
+constexpr bool isIdentStartChar(char c) {
+  return isCharClass(c, CHAR_IDENT_START);
+}
+
+constexpr bool isIdentChar(char c) { return isCharClass(c, CHAR_IDENT); }
+
+// value of a byte for which isHexDigitChar is true
+constexpr unsigned hexDigitValue(char c) {
+  return isDigitChar(c) ? (c - '0') : ((c | 0x20) - 'a' + 10);
+}
+
+// first byte in [begin, end) that can't continue an identifier
+inline const char* skipIdentChars(const char* begin, const char* end) {
+  while ((begin < end) && isIdentChar(*begin)) {
+    ++begin;
+  }
+  return begin;
+}
+
+// first byte in [begin, end) that isn't classified as cls
+inline const char* skipCharClass(const char* begin, const char* end,
+                                 uint8_t cls) {
+  while ((begin < end) && isCharClass(*begin, cls)) {
+    ++begin;
+  }
+  return begin;
+}
+#endif  // SRC_CHAR_CLASS_H_
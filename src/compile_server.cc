@@ -0,0 +1,301 @@
+#include "compile_server.h"
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#include "aycc.h"
+#include "errors.h"
+#include "header_search.h"
+#include "para_init.h"
+#include "source_manager.h"
+#include "thread_pool.h"
+
+// longest string a message may carry, anything bigger is a broken peer
+static constexpr uint32_t max_string_size = 1u << 30;
+// a client silent this long is given up, its thread serves the next one
+static constexpr time_t client_timeout_seconds = 30;
+// handlers of clients at least, one waiting on a slow client leaves others
+static constexpr size_t min_client_threads = 4;
+// stale revisions held before new requests wait to have them evicted
+static constexpr size_t max_stale_files = 1024;
+
+static bool writeAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+static bool readAll(int fd, char* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = recv(fd, data, size, 0);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (n == 0) {
+      return false;
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+// a message is a count of strings, then every string with its size first
+static bool sendStrings(int fd, const std::vector<std::string>& strings) {
+  std::string message;
+  uint32_t count = static_cast<uint32_t>(strings.size());
+  message.append(reinterpret_cast<const char*>(&count), sizeof(count));
+  for (const auto& text : strings) {
+    uint32_t size = static_cast<uint32_t>(text.size());
+    message.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    message += text;
+  }
+  return writeAll(fd, message.data(), message.size());
+}
+
+static bool receiveStrings(int fd, std::vector<std::string>& strings) {
+  uint32_t count;
+  if (!readAll(fd, reinterpret_cast<char*>(&count), sizeof(count))) {
+    return false;
+  }
+  strings.clear();
+  for (uint32_t index = 0; index < count; ++index) {
+    uint32_t size;
+    if ((!readAll(fd, reinterpret_cast<char*>(&size), sizeof(size))) ||
+        (size > max_string_size)) {
+      return false;
+    }
+    std::string text(size, '\0');
+    if ((size > 0) && (!readAll(fd, &text[0], size))) {
+      return false;
+    }
+    strings.push_back(std::move(text));
+  }
+  return true;
+}
+
+static bool makeAddress(const std::string& path, sockaddr_un& address) {
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+static int connectTo(const std::string& path) {
+  sockaddr_un address;
+  if (!makeAddress(path, address)) {
+    return -1;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  if (connect(fd, reinterpret_cast<const sockaddr*>(&address),
+              sizeof(address)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+CompileServer::CompileServer(const std::string& path)
+    : path_(path),
+      includes_(),
+      mutex_(),
+      idle_(),
+      active_(0),
+      draining_(false) {}
+
+bool CompileServer::serve() {
+  sockaddr_un address;
+  if (!makeAddress(path_, address)) {
+    std::cerr << "socket path too long [" << path_ << "]" << std::endl;
+    return false;
+  }
+
+  // a socket nobody answers on is left over from a server gone
+  int running = connectTo(path_);
+  if (running >= 0) {
+    close(running);
+    std::cerr << "a server is already listening on [" << path_ << "]"
+              << std::endl;
+    return false;
+  }
+  unlink(path_.c_str());
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if ((fd < 0) ||
+      (bind(fd, reinterpret_cast<const sockaddr*>(&address),
+            sizeof(address)) != 0) ||
+      (listen(fd, SOMAXCONN) != 0)) {
+    std::cerr << "can't listen on [" << path_ << "]: " << std::strerror(errno)
+              << std::endl;
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+
+  {
+    // clients are handled side by side, each compiling on a pool of its own
+    ThreadPool pool(std::max<size_t>(std::thread::hardware_concurrency(),
+                                     min_client_threads));
+    for (;;) {
+      int client = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+      if (client < 0) {
+        if ((errno == EINTR) || (errno == ECONNABORTED)) {
+          continue;
+        }
+        break;
+      }
+      timeval timeout{client_timeout_seconds, 0};
+      setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+      pool.submit([this, client](size_t) {
+        handle(client);
+        close(client);
+      });
+    }
+  }
+  close(fd);
+  unlink(path_.c_str());
+  return true;
+}
+
+bool CompileServer::forward(const std::string& path, int argc, char** argv,
+                            int& status) {
+  int fd = connectTo(path);
+  if (fd < 0) {
+    return false;
+  }
+
+  std::vector<std::string> request;
+  std::unique_ptr<char, decltype(&free)> cwd(getcwd(nullptr, 0), &free);
+  request.push_back((cwd) ? (cwd.get()) : ("."));
+  for (int index = 1; index < argc; ++index) {
+    request.push_back(argv[index]);
+  }
+
+  // request: working directory, arguments. reply: status, stdout, stderr
+  std::vector<std::string> reply;
+  bool answered = (sendStrings(fd, request)) && (receiveStrings(fd, reply)) &&
+                  (reply.size() == 3);
+  close(fd);
+  if (!answered) {
+    return false;
+  }
+
+  std::cout << reply[1] << std::flush;
+  std::cerr << reply[2] << std::flush;
+  status = std::atoi(reply[0].c_str());
+  return true;
+}
+
+void CompileServer::handle(int client) {
+  std::vector<std::string> request;
+  if ((!receiveStrings(client, request)) || (request.empty())) {
+    return;
+  }
+
+  // paths are taken from the directory of the client, the working directory
+  // of the server is shared by every request
+  std::string dir = request[0];
+  request[0] = "AYCC";
+  std::ostringstream out;
+  std::ostringstream err;
+  size_t max_jobs = beginRequest();
+  int status = compile(dir, request, max_jobs, out, err);
+  endRequest();
+  sendStrings(client, {std::to_string(status), out.str(), err.str()});
+}
+
+int CompileServer::compile(const std::string& dir,
+                           const std::vector<std::string>& args,
+                           size_t max_jobs, std::ostream& out,
+                           std::ostream& err) {
+  std::vector<std::string> strings(args);
+  std::vector<char*> argv;
+  for (auto& arg : strings) {
+    argv.push_back(&arg[0]);
+  }
+  argv.push_back(nullptr);
+
+  try {
+    ParaInit para_init(static_cast<int>(strings.size()), argv.data(), dir,
+                       err);
+    if (!para_init.isValid()) {
+      return 1;
+    }
+    Aycc aycc(para_init, out, err, includes_, max_jobs);
+    aycc.run();
+  } catch (const CompilerError& e) {
+    err << e << std::endl;
+    return 1;
+  } catch (const std::exception& e) {
+    // anything else fails the request alone, an exception leaving the task
+    // would end the server
+    err << CompilerError(DiagID::INTERNAL_ERROR, e.what()) << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+// files changed since the last request go stale here, unless too many are
+// held already, then the running requests are let end first. the cores are
+// shared by the requests running, so they don't oversubscribe the machine
+size_t CompileServer::beginRequest() {
+  size_t active;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if ((active_ > 0) &&
+        (SourceManager::instance().getStaleCount() >= max_stale_files)) {
+      draining_ = true;
+    }
+    idle_.wait(lock, [this] { return !draining_; });
+    active = ++active_;
+  }
+  // headers may have been added or removed since an earlier request
+  HeaderSearch::instance().forgetLookups();
+  SourceManager::instance().refresh();
+  size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+  return std::max<size_t>(cores / active, 1);
+}
+
+// the last request running evicts, no tokens of a stale revision are held
+// by anyone then
+void CompileServer::endRequest() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (--active_ > 0) {
+    return;
+  }
+  includes_.evictStale();
+  SourceManager::instance().releaseStale();
+  draining_ = false;
+  idle_.notify_all();
+}
@@ -0,0 +1,54 @@
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "include_cache.h"
+
+#ifndef SRC_COMPILE_SERVER_H_
+#define SRC_COMPILE_SERVER_H_
+
+/*
+ CompileServer representing a resident compiler taking command lines over a
+ Unix domain socket, several at a time sharing the cores, so the Interner,
+ the SourceManager and the headers lexed stay warm from one to the next.
+ Revisions of files changed since are evicted whenever no request runs
+ path_ - Path of the socket
+ includes_ - Headers lexed by every request so far
+ mutex_ - Guards active_ and draining_
+ idle_ - Signaled when stale revisions are evicted
+ active_ - Requests running
+ draining_ - True while new requests wait for the running ones to end, so
+             the stale revisions piled up get evicted
+ */
+class CompileServer {
+ public:
+  explicit CompileServer(const std::string& path);
+
+ public:
+  // serve until the socket fails, false if it can't be set up
+  bool serve();
+
+  // run argv in the working directory on the server listening at path,
+  // false if none answers so the caller compiles in-process
+  static bool forward(const std::string& path, int argc, char** argv,
+                      int& status);
+
+ private:
+  void handle(int client);
+  int compile(const std::string& dir, const std::vector<std::string>& args,
+              size_t max_jobs, std::ostream& out, std::ostream& err);
+  // the number of files the request may compile at once
+  size_t beginRequest();
+  void endRequest();
+
+ private:
+  std::string path_;
+  IncludeCache includes_;
+  std::mutex mutex_;
+  std::condition_variable idle_;
+  size_t active_;
+  bool draining_;
+};
+#endif  // SRC_COMPILE_SERVER_H_
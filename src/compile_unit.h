@@ -0,0 +1,59 @@
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "arena.h"
+#include "errors.h"
+#include "header_search.h"
+#include "token_dump.h"
+
+#ifndef SRC_COMPILE_UNIT_H_
+#define SRC_COMPILE_UNIT_H_
+
+class IncludeCache;
+class ThreadPool;
+class TokenCache;
+struct IncludeCounts;
+
+/*
+ CompileUnit representing the state of compiling one input file, used by a
+ single thread at a time
+ arena_ - Arena the tokens of the file are allocated from
+ errors_ - Errors found in the file
+ out_ - Stream the debug output of the file is written to
+ dump_ - Format the tokens of the file are printed to out_ in
+ parallel_lex_size_ - Files this big or bigger are lexed in parallel
+                      chunks, 0 to always lex serially
+ lex_pool_ - Pool the chunks are lexed on, shared by every file of the run,
+             nullptr to always lex serially
+ includes_ - Headers expanded so far in the run, nullptr to lex every
+             include again
+ token_cache_ - Headers lexed by earlier runs, nullptr if not used
+ include_counts_ - Counts of how includes_ served the run, nullptr for none
+ search_ - Directories included files are looked for in
+ error_limit_ - Errors after which the rest of the file is given up, 0 for
+                no limit
+ */
+struct CompileUnit {
+  Arena& arena_;
+  std::vector<CompilerError>& errors_;
+  std::ostream& out_;
+  TokenDump dump_;
+  size_t parallel_lex_size_;
+  ThreadPool* lex_pool_;
+  IncludeCache* includes_;
+  const TokenCache* token_cache_;
+  IncludeCounts* include_counts_;
+  SearchID search_;
+  size_t error_limit_;
+
+  // errors the file may still report before it is given up
+  size_t getErrorRoom() const {
+    if (error_limit_ == 0) {
+      return std::numeric_limits<size_t>::max();
+    }
+    return (errors_.size() < error_limit_) ? (error_limit_ - errors_.size())
+                                           : (0);
+  }
+};
+#endif  // SRC_COMPILE_UNIT_H_
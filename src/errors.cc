@@ -1,21 +1,40 @@
 #include "errors.h"
 
-Position::Position(const std::string& file, size_t line, size_t col,
-                   const std::string& full_line)
-    : file_(file), line_(line), col_(col), full_line_(full_line) {}
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include <boost/utility/string_ref.hpp>
+
+#include "source_buffer.h"
+
+Position::Position(FileID file, uint32_t offset)
+    : file_(file), offset_(offset) {}
 
 Position& Position::operator++() {
-  ++col_;
+  ++offset_;
   return *this;
 }
 
-std::string Position::getFile() const { return file_; }
+FileID Position::getFileID() const { return file_; }
+
+uint32_t Position::getOffset() const { return offset_; }
 
-size_t Position::getLine() const { return line_; }
+std::string Position::getFile() const {
+  return SourceManager::instance().getFileName(file_);
+}
+
+size_t Position::getLine() const {
+  return SourceManager::instance().getLine(file_, offset_);
+}
 
-size_t Position::getColumn() const { return col_; }
+size_t Position::getColumn() const {
+  return SourceManager::instance().getColumn(file_, offset_);
+}
 
-std::string Position::getFullLine() const { return full_line_; }
+std::string Position::getFullLine() const {
+  return SourceManager::instance().getLineText(file_, offset_);
+}
 
 Range::Range(const Position& be, const Position& en) : be_(be), en_(en) {}
 
@@ -27,67 +46,171 @@ Position Range::getBegin() const { return be_; }
 
 Position Range::getEnd() const { return en_; }
 
-CompilerError::CompilerError(const std::string& descrip,
-                             std::shared_ptr<Range> range, bool warning)
-    : descrip_(descrip), range_(range), warning_(warning) {}
+// "{}" is where the argument goes
+static const char* const diag_texts[] = {
+    "too many distinct identifiers and strings",
+    "extra tokens at end of include directive",
+    "expected \"FILENAME\" or <FILENAME> after include directive",
+    "missing terminating character for include filename",
+    "missing terminating quote",
+    "empty character constant",
+    "multiple characters in character constant",
+    "unrecognized token at {}",
+    "unable to read included file",
+    "could't open include file {}",
+    "recursive include of file",
+    "invalid file id {}",
+    "unknown file type [{}]",
+    "file can't open [{}]",
+    "too many errors, the rest of [{}] is skipped",
+    "can't write dependencies [{}]",
+    "can't write build manifest [{}]",
+    "not enough number of properly processed files to link",
+    "unknown token dump format [{}], expected text, jsonl or bin",
+    "can't write dump file [{}]",
+    "internal error compiling {}",
+};
+static_assert(sizeof(diag_texts) / sizeof(*diag_texts) ==
+                  static_cast<size_t>(DiagID::COUNT),
+              "every DiagID needs a text");
+
+// longest part of a source line quoted under a diagnostic
+static constexpr size_t max_snippet_size = 160;
+
+CompilerError::CompilerError(DiagID id, bool warning)
+    : range_(),
+      arg_(),
+      id_(id),
+      has_range_(false),
+      warning_(warning) {}
+
+CompilerError::CompilerError(DiagID id, const std::string& arg, bool warning)
+    : range_(),
+      arg_(std::make_shared<const std::string>(arg)),
+      id_(id),
+      has_range_(false),
+      warning_(warning) {}
+
+CompilerError::CompilerError(DiagID id, const Range& range, bool warning)
+    : range_(range),
+      arg_(),
+      id_(id),
+      has_range_(true),
+      warning_(warning) {}
 
 const char* CompilerError::what() const throw() {
-  std::string location = "";
-  std::string type = (warning_) ? ("warning") : ("error");
-
-  if (range_.get() != nullptr) {
-    location += range_->getBegin().getFile() + ": ";
-    location += "[ (" + std::to_string(range_->getBegin().getLine()) + "," +
-                std::to_string(range_->getBegin().getColumn()) + ") ";
-    location += "(" + std::to_string(range_->getEnd().getLine()) + "," +
-                std::to_string(range_->getEnd().getColumn()) + ") ] ";
-  }
-
-  std::string info = "";
-  info += "[" + type + "] " + location + descrip_;
-  return info.c_str();
+  static thread_local std::string text;
+  text.clear();
+  renderMessage(text);
+  return text.c_str();
 }
 
 bool CompilerError::isWarning() const { return warning_; }
 
-bool operator<(const CompilerError& lce, const CompilerError& rce) {
-  // nullptr is before with range
-  if (lce.range_.get() == nullptr) {
-    return rce.range_.get() != nullptr;
+void CompilerError::render(std::string& out) const {
+  renderMessage(out);
+  if (has_range_) {
+    renderSnippet(out);
   }
+}
 
-  if (rce.range_.get() == nullptr) {
-    return false;
+void CompilerError::renderMessage(std::string& out) const {
+  out += (warning_) ? ("[warning] ") : ("[error] ");
+  if (has_range_) {
+    Position begin = range_.getBegin();
+    Position end = range_.getEnd();
+    out += begin.getFile();
+    out += ": [ (" + std::to_string(begin.getLine()) + "," +
+           std::to_string(begin.getColumn()) + ") (" +
+           std::to_string(end.getLine()) + "," +
+           std::to_string(end.getColumn()) + ") ] ";
   }
 
-  return (lce.range_->getBegin().getLine() <
-          rce.range_->getBegin().getLine()) ||
-         ((lce.range_->getBegin().getLine() ==
-           rce.range_->getBegin().getLine()) &&
-          (lce.range_->getBegin().getColumn() <
-           rce.range_->getBegin().getColumn()));
+  boost::string_ref text(diag_texts[static_cast<size_t>(id_)]);
+  size_t hole = text.find("{}");
+  if (hole == boost::string_ref::npos) {
+    out.append(text.data(), text.size());
+    return;
+  }
+  out.append(text.data(), hole);
+  if (arg_) {
+    out += *arg_;
+  } else if (has_range_) {
+    // the text of the range, as the lexer saw it without line splices
+    const SourceBuffer& buffer =
+        SourceManager::instance().getBuffer(range_.getBegin().getFileID());
+    const char* first = buffer.begin() + range_.getBegin().getOffset();
+    const char* last = buffer.begin() + range_.getEnd().getOffset();
+    for (const char* c = first; (c <= last) && (c < buffer.end()); ++c) {
+      if ((*c == '\\') && (c + 1 < buffer.end()) && (*(c + 1) == '\n')) {
+        ++c;
+        continue;
+      }
+      out += *c;
+    }
+  }
+  out.append(text.data() + hole + 2, text.size() - hole - 2);
 }
 
-std::ostream& operator<<(std::ostream& os, const CompilerError& ce) {
-  std::string location = "";
-  std::string type = (ce.warning_) ? ("warning") : ("error");
-
-  if (ce.range_.get() != nullptr) {
-    location += ce.range_->getBegin().getFile() + ": ";
-    location += "[ (" + std::to_string(ce.range_->getBegin().getLine()) + "," +
-                std::to_string(ce.range_->getBegin().getColumn()) + ") ";
-    location += "(" + std::to_string(ce.range_->getEnd().getLine()) + "," +
-                std::to_string(ce.range_->getEnd().getColumn()) + ") ] ";
+void CompilerError::renderSnippet(std::string& out) const {
+  Position begin = range_.getBegin();
+  const SourceBuffer& buffer =
+      SourceManager::instance().getBuffer(begin.getFileID());
+  if (begin.getOffset() >= buffer.size()) {
+    return;
   }
 
-  os << "[" << type << "] " << location << ce.descrip_;
-  return os;
+  // a window of a long line, around where the range starts
+  size_t column = begin.getColumn() - 1;
+  const char* line = buffer.begin() + begin.getOffset() - column;
+  size_t skipped =
+      (column > max_snippet_size / 2) ? (column - max_snippet_size / 2) : (0);
+  const char* first = line + skipped;
+  const char* last = static_cast<const char*>(
+      memchr(first, '\n', std::min<size_t>(buffer.end() - first,
+                                           max_snippet_size)));
+  last = (last != nullptr)
+             ? (last)
+             : (first + std::min<size_t>(buffer.end() - first,
+                                         max_snippet_size));
+
+  out += "\n    ";
+  out.append(first, last);
+  out += "\n    ";
+  // tabs stay tabs so the caret lines up however they are shown
+  const char* caret = line + column;
+  for (const char* c = first; c < caret; ++c) {
+    out += (*c == '\t') ? ('\t') : (' ');
+  }
+  out += '^';
+  Position end = range_.getEnd();
+  if ((end.getFileID() == begin.getFileID()) &&
+      (end.getOffset() > begin.getOffset())) {
+    const char* underline_end =
+        std::min(buffer.begin() + end.getOffset() + 1, last);
+    for (const char* c = caret + 1; c < underline_end; ++c) {
+      out += '~';
+    }
+  }
 }
 
-Tagged::Tagged(char c, const Position& p) : c_(c), p_(p), r_(p_, p_) {}
+bool operator<(const CompilerError& lce, const CompilerError& rce) {
+  // without range is before with range
+  if (!lce.has_range_) {
+    return rce.has_range_;
+  }
 
-char Tagged::getC() const { return c_; }
+  if (!rce.has_range_) {
+    return false;
+  }
 
-Position Tagged::getPosition() const { return p_; }
+  // offsets order the same way as (line, column) without computing them
+  return lce.range_.getBegin().getOffset() < rce.range_.getBegin().getOffset();
+}
 
-Range Tagged::getRange() const { return r_; }
\ No newline at end of file
+std::ostream& operator<<(std::ostream& os, const CompilerError& ce) {
+  std::string text;
+  ce.render(text);
+  os << text;
+  return os;
+}
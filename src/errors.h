@@ -1,36 +1,38 @@
+#include <cstdint>
 #include <exception>
 #include <iostream>
 #include <memory>
 #include <string>
 
+#include "source_manager.h"
+
 #ifndef SRC_ERRORS_H_
 #define SRC_ERRORS_H_
 
 /*
  Position representing a position in source code
- file_ - Name of file
- line_ - Line numer in file
- col_ - Column number in file
- full_line_ - Full text of the line
+ file_ - File the position is in, resolved through the SourceManager
+ offset_ - Byte offset from the beginning of the file
  */
 class Position {
  public:
-  Position(const std::string& file, size_t line, size_t col,
-           const std::string& full_line);
+  Position(FileID file = 0, uint32_t offset = 0);
 
  public:
   Position& operator++();
 
+  FileID getFileID() const;
+  uint32_t getOffset() const;
+
+  // computed by the SourceManager, only needed when printing diagnostics
   std::string getFile() const;
   size_t getLine() const;
   size_t getColumn() const;
   std::string getFullLine() const;
 
  private:
-  std::string file_;
-  size_t line_;
-  size_t col_;
-  std::string full_line_;
+  FileID file_;
+  uint32_t offset_;
 };
 
 /*
@@ -40,7 +42,7 @@ class Position {
  */
 class Range {
  public:
-  Range(const Position& be, const Position& en);
+  Range(const Position& be = Position(), const Position& en = Position());
 
  public:
   friend Range operator+(const Range& lrg, const Range& rrg);
@@ -56,44 +58,74 @@ class Range {
 Range operator+(const Range& lrg, const Range& rrg);
 
 /*
- CompilerError representing compile-time errors
- descrip_ - Description of the error
+ DiagID representing what a diagnostic says, its text is put together only
+ when it is printed
+ */
+enum class DiagID : uint8_t {
+  TOO_MANY_SYMBOLS,
+  EXTRA_INCLUDE_TOKENS,
+  EXPECTED_INCLUDE_FILENAME,
+  UNTERMINATED_INCLUDE_FILENAME,
+  MISSING_QUOTE,
+  EMPTY_CHAR,
+  MULTI_CHAR,
+  UNRECOGNIZED_TOKEN,
+  UNREADABLE_INCLUDE,
+  CANT_OPEN_INCLUDE,
+  RECURSIVE_INCLUDE,
+  INVALID_FILE_ID,
+  UNKNOWN_FILE_TYPE,
+  CANT_OPEN_FILE,
+  TOO_MANY_ERRORS,
+  CANT_WRITE_DEPS,
+  CANT_WRITE_MANIFEST,
+  NOT_ENOUGH_FILES,
+  UNKNOWN_DUMP_FORMAT,
+  CANT_WRITE_DUMP_FILE,
+  INTERNAL_ERROR,
+  // number of ids, not one itself
+  COUNT
+};
+
+/*
+ CompilerError representing compile-time errors, kept small since a broken
+ file can have many: the text is rendered from id_ and arg_ when printed,
+ with the line of range_ quoted from the source
  range_ - Range at which the error appears
+ arg_ - Text filled into the message, shared by the copies of the error,
+        nullptr for none. not interned, so a resident server doesn't keep
+        every file name it ever reported
+ id_ - What the error says
+ has_range_ - False if the error isn't tied to the source
  warning_ - True if this is a warning
  */
 class CompilerError : public std::exception {
  public:
-  CompilerError(const std::string& descrip,
-                std::shared_ptr<Range> range = std::shared_ptr<Range>(nullptr),
-                bool warning = false);
+  explicit CompilerError(DiagID id, bool warning = false);
+  CompilerError(DiagID id, const std::string& arg, bool warning = false);
+  CompilerError(DiagID id, const Range& range, bool warning = false);
 
  public:
+  // valid until the next call in the same thread
   virtual const char* what() const throw();
   bool isWarning() const;
+  // the message, then the line of the range with a caret under it
+  void render(std::string& out) const;
   friend bool operator<(const CompilerError& lce, const CompilerError& rce);
   friend std::ostream& operator<<(std::ostream& os, const CompilerError& ce);
 
  private:
-  std::string descrip_;
-  std::shared_ptr<Range> range_;
+  void renderMessage(std::string& out) const;
+  void renderSnippet(std::string& out) const;
+
+ private:
+  Range range_;
+  std::shared_ptr<const std::string> arg_;
+  DiagID id_;
+  bool has_range_;
   bool warning_;
 };
 
 bool operator<(const CompilerError& lce, const CompilerError& rce);
 std::ostream& operator<<(std::ostream& os, const CompilerError& ce);
-
-class Tagged {
- public:
-  Tagged(char c, const Position& p);
-
- public:
-  char getC() const;
-  Position getPosition() const;
-  Range getRange() const;
-
- private:
-  char c_;
-  Position p_;
-  Range r_;
-};
 #endif  // SRC_ERRORS_H_
@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#ifndef SRC_GAP_VECTOR_H_
+#define SRC_GAP_VECTOR_H_
+
+/*
+ GapVector representing a sequence with a gap to insert at, kept where the
+ last edit was so the next one nearby moves only the items in between.
+ Offsets after the gap are best kept counted from the end of what they are
+ offsets in, then an edit before them doesn't change them
+ items_ - Items before the gap, the gap, then items after the gap
+ gap_begin_, gap_end_ - Gap in items_
+ */
+template <typename T>
+class GapVector {
+ public:
+  GapVector() : items_(), gap_begin_(0), gap_end_(0) {}
+
+ public:
+  size_t size() const { return items_.size() - (gap_end_ - gap_begin_); }
+  size_t frontSize() const { return gap_begin_; }
+  size_t backSize() const { return items_.size() - gap_end_; }
+
+  const T& operator[](size_t index) const {
+    return (index < gap_begin_) ? (items_[index])
+                                : (items_[index + gap_end_ - gap_begin_]);
+  }
+  const T& firstBack() const { return items_[gap_end_]; }
+  const T& lastFront() const { return items_[gap_begin_ - 1]; }
+
+  void pushFront(const T& item) {
+    if (gap_begin_ == gap_end_) {
+      // twice the room, the back moved to the end
+      size_t back = backSize();
+      size_t grown = (items_.size() < 64) ? (64) : (items_.size() * 2);
+      items_.resize(grown);
+      std::move_backward(items_.begin() + gap_end_,
+                         items_.begin() + gap_end_ + back, items_.end());
+      gap_end_ = grown - back;
+    }
+    items_[gap_begin_++] = item;
+  }
+  void dropBack(size_t count) { gap_end_ += count; }
+  // the first back item becomes the last front one, and the other way
+  void moveToFront(const T& item) {
+    ++gap_end_;
+    items_[gap_begin_++] = item;
+  }
+  void moveToBack(const T& item) {
+    --gap_begin_;
+    items_[--gap_end_] = item;
+  }
+
+ private:
+  std::vector<T> items_;
+  size_t gap_begin_;
+  size_t gap_end_;
+};
+#endif  // SRC_GAP_VECTOR_H_
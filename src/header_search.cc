@@ -0,0 +1,104 @@
+#include "header_search.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+
+#include <boost/filesystem.hpp>
+
+HeaderSearch& HeaderSearch::instance() {
+  static HeaderSearch search;
+  return search;
+}
+
+HeaderSearch::HeaderSearch()
+    : lists_(), found_(), missing_(), mutex_() {
+  addSearchList({}, {});
+}
+
+SearchID HeaderSearch::addSearchList(
+    const std::vector<std::string>& user_dirs,
+    const std::vector<std::string>& system_dirs) {
+  std::vector<std::string> list(user_dirs);
+  list.insert(list.end(), system_dirs.begin(), system_dirs.end());
+  // standard headers come with the compiler
+  list.push_back(boost::filesystem::path(__FILE__)
+                     .parent_path()
+                     .parent_path()
+                     .append("include")
+                     .string());
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = std::find(lists_.begin(), lists_.end(), list);
+  if (found != lists_.end()) {
+    return static_cast<SearchID>(found - lists_.begin());
+  }
+  lists_.push_back(std::move(list));
+  return static_cast<SearchID>(lists_.size() - 1);
+}
+
+std::vector<std::string> HeaderSearch::getSearchList(SearchID id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return lists_.at(id);
+}
+
+bool HeaderSearch::find(SearchID id, const std::string& from,
+                        const std::string& spelling, std::string& path) {
+  namespace bf = boost::filesystem;
+  if (spelling.size() < 2) {
+    return false;
+  }
+  bool quoted = (spelling[0] == '\"');
+  std::string name = spelling.substr(1, spelling.size() - 2);
+
+  // the directory of the includer only matters to "name"
+  std::string key = std::to_string(id) + '\0' +
+                    ((quoted) ? (from) : (std::string())) + '\0' + name;
+  std::vector<std::string> dirs;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = found_.find(key);
+    if (found != found_.end()) {
+      path = found->second;
+      return true;
+    }
+    dirs = lists_.at(id);
+  }
+  if (quoted) {
+    dirs.insert(dirs.begin(), from);
+  }
+
+  for (const auto& dir : dirs) {
+    std::string candidate = bf::path(dir).append(name).string();
+    if (isFile(candidate)) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      found_[key] = candidate;
+      path = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+void HeaderSearch::forgetLookups() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  found_.clear();
+  missing_.clear();
+}
+
+bool HeaderSearch::isFile(const std::string& path) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (missing_.count(path) != 0) {
+      return false;
+    }
+  }
+
+  struct stat st;
+  if ((stat(path.c_str(), &st) == 0) && (!S_ISDIR(st.st_mode))) {
+    return true;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  missing_.insert(path);
+  return false;
+}
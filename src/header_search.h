@@ -0,0 +1,53 @@
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifndef SRC_HEADER_SEARCH_H_
+#define SRC_HEADER_SEARCH_H_
+
+using SearchID = uint32_t;
+
+/*
+ HeaderSearch representing where included files are looked for, shared by
+ the threads compiling files in parallel. A name found once resolves again
+ without touching the file system, and a path found missing isn't asked
+ for again
+ lists_ - Directories of every search list, by SearchID: the -I ones, the
+          -isystem ones, then the include directory of the compiler
+ found_ - Path resolved for a search list, including directory and spelling
+ missing_ - Paths known not to be a file
+ mutex_ - Guards lists_, found_ and missing_
+ */
+class HeaderSearch {
+ public:
+  static HeaderSearch& instance();
+
+ public:
+  // the search list of -I and -isystem directories, equal lists share an id.
+  // the default one, with neither, is 0
+  SearchID addSearchList(const std::vector<std::string>& user_dirs,
+                         const std::vector<std::string>& system_dirs);
+  std::vector<std::string> getSearchList(SearchID id) const;
+
+  // path an include spelled "name" or <name> in a file of directory from
+  // resolves to, false if there is none. "name" is looked for in from first
+  bool find(SearchID id, const std::string& from, const std::string& spelling,
+            std::string& path);
+  // files may have been created or removed since the lookups were cached
+  void forgetLookups();
+
+ private:
+  HeaderSearch();
+
+  bool isFile(const std::string& path);
+
+ private:
+  std::vector<std::vector<std::string>> lists_;
+  std::unordered_map<std::string, std::string> found_;
+  std::unordered_set<std::string> missing_;
+  mutable std::mutex mutex_;
+};
+#endif  // SRC_HEADER_SEARCH_H_
@@ -0,0 +1,155 @@
+#include "include_cache.h"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+#include "preproc.h"
+#include "token_cache.h"
+
+// small headers are the common case, big ones get blocks their own size
+static constexpr size_t min_block_size = 4 * 1024;
+
+IncludeCache::Entry::Entry(FileID file, size_t block_size,
+                           size_t error_limit, uint64_t generation)
+    : arena_(block_size),
+      tokens_(file, arena_),
+      errors_(),
+      out_(),
+      includes_(),
+      guard_(),
+      error_limit_(error_limit),
+      generation_(generation),
+      built_(false),
+      failed_(false) {}
+
+bool IncludeCache::Entry::isEnoughFor(size_t error_limit) const {
+  bool stopped = (error_limit_ > 0) && (errors_.size() >= error_limit_);
+  return (!stopped) || ((error_limit > 0) && (error_limit <= error_limit_));
+}
+
+bool IncludeCache::Key::operator==(const Key& other) const {
+  return (file_ == other.file_) && (search_ == other.search_) &&
+         (dump_ == other.dump_);
+}
+
+size_t IncludeCache::KeyHash::operator()(const Key& key) const {
+  size_t hash = std::hash<FileID>()(key.file_);
+  hash = hash * 31 + std::hash<SearchID>()(key.search_);
+  return hash * 31 + static_cast<size_t>(key.dump_);
+}
+
+IncludeCache::IncludeCache()
+    : entries_(), retired_(), mutex_(), built_() {}
+
+IncludeCache::~IncludeCache() {}
+
+const IncludeCache::Entry& IncludeCache::get(FileID file,
+                                             const CompileUnit& unit) {
+  size_t block_size = std::max(
+      min_block_size, SourceManager::instance().getBuffer(file).size());
+  // taken first, a file going stale while the header is lexed is seen later
+  uint64_t generation = SourceManager::instance().getGeneration();
+
+  // includes of a header resolve differently with other search lists
+  Key key{file, unit.search_, unit.dump_};
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    auto found = entries_.find(key);
+    if (found == entries_.end()) {
+      break;
+    }
+    Entry& entry = *found->second;
+    // another thread may still be lexing it, lexing never waits on others
+    built_.wait(lock, [&entry] { return entry.built_; });
+    // gone from entries_ when lexing it threw, looked up again to lex it here
+    if (entry.failed_) {
+      continue;
+    }
+    if ((entry.isEnoughFor(unit.error_limit_)) &&
+        (isCurrent(entry, generation))) {
+      if (unit.include_counts_ != nullptr) {
+        ++unit.include_counts_->hits_;
+      }
+      return entry;
+    }
+
+    // given up under a lower error limit or including a stale file, lexed
+    // again unless another thread did while this one waited
+    auto current = entries_.find(key);
+    if ((current != entries_.end()) && (current->second.get() == &entry)) {
+      retired_.push_back(std::move(current->second));
+      entries_.erase(current);
+    }
+  }
+
+  if (unit.include_counts_ != nullptr) {
+    ++unit.include_counts_->misses_;
+  }
+  std::unique_ptr<Entry> created(
+      new Entry(file, block_size, unit.error_limit_, generation));
+  Entry& entry = *created;
+  entries_.emplace(key, std::move(created));
+  lock.unlock();
+  try {
+    fill(file, unit, entry);
+  } catch (...) {
+    // what was lexed is never served, the threads waiting lex it themselves
+    lock.lock();
+    auto current = entries_.find(key);
+    if ((current != entries_.end()) && (current->second.get() == &entry)) {
+      retired_.push_back(std::move(current->second));
+      entries_.erase(current);
+    }
+    entry.failed_ = true;
+    entry.built_ = true;
+    built_.notify_all();
+    throw;
+  }
+  lock.lock();
+  entry.built_ = true;
+  built_.notify_all();
+  return entry;
+}
+
+void IncludeCache::evictStale() {
+  const SourceManager& manager = SourceManager::instance();
+  uint64_t generation = manager.getGeneration();
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto entry = entries_.begin(); entry != entries_.end();) {
+    bool current = (manager.isCurrent(entry->first.file_)) &&
+                   (isCurrent(*entry->second, generation));
+    entry = (current) ? (std::next(entry)) : (entries_.erase(entry));
+  }
+  retired_.clear();
+}
+
+// nothing changed since it was last checked, or every file it includes is
+// still the revision it was lexed with
+bool IncludeCache::isCurrent(Entry& entry, uint64_t generation) {
+  if (entry.generation_ == generation) {
+    return true;
+  }
+  for (const auto& included : entry.includes_) {
+    if (!SourceManager::instance().isCurrent(included.file_)) {
+      return false;
+    }
+  }
+  entry.generation_ = generation;
+  return true;
+}
+
+void IncludeCache::fill(FileID file, const CompileUnit& unit, Entry& entry) {
+  const TokenCache* disk = unit.token_cache_;
+  if ((disk != nullptr) && (disk->load(file, unit, entry))) {
+    if (unit.include_counts_ != nullptr) {
+      ++unit.include_counts_->loads_;
+    }
+    return;
+  }
+  PreProc::lexHeader(file, unit, entry);
+  if (disk != nullptr) {
+    disk->store(file, unit, entry);
+  }
+}
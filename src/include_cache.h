@@ -0,0 +1,138 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "arena.h"
+#include "compile_unit.h"
+#include "errors.h"
+#include "include_guard.h"
+#include "source_manager.h"
+#include "token_stream.h"
+#include "tokens.h"
+
+#ifndef SRC_INCLUDE_CACHE_H_
+#define SRC_INCLUDE_CACHE_H_
+
+/*
+ IncludeCounts representing how the includes of one run were served, so a
+ compile server reports every request on its own
+ hits_, misses_ - Includes served from the IncludeCache and headers not in it
+ loads_ - Headers of misses_ loaded from the TokenCache instead of lexed
+ */
+struct IncludeCounts {
+  std::atomic<size_t> hits_{0};
+  std::atomic<size_t> misses_{0};
+  std::atomic<size_t> loads_{0};
+};
+
+/*
+ IncludeCache representing every header lexed during one run, or during
+ every request to the compile server, shared by the threads compiling files
+ in parallel. A file is keyed by its FileID, which SourceManager hands out
+ per path, size and mtime, so a changed header gets an entry of its own, by
+ its search list and by how tokens are dumped, which changes its output. An
+ entry including a revision gone stale is lexed again, so its includes find
+ the new one
+ entries_ - Every header lexed or being lexed
+ retired_ - Headers lexed again under a higher error limit or after an
+            include went stale, and headers whose lexing threw, kept for
+            the files still expanding or waiting on them
+ mutex_ - Guards entries_, retired_ and built_ and generation_ of entries
+ built_ - Signaled when a header is lexed
+ */
+class IncludeCache {
+ public:
+  /*
+   Include representing an include in a header, expanded when it is reached
+   token_, error_, out_ - Tokens, errors and output of the header before it
+   file_ - File included
+   filename_ - "file" or <file> token of the include
+   */
+  struct Include {
+    size_t token_;
+    size_t error_;
+    size_t out_;
+    FileID file_;
+    Token filename_;
+  };
+
+  /*
+   Entry representing one header as lexed, its includes left to expand
+   since what they expand to depends on what was included before
+   arena_ - Arena tokens_ is allocated from
+   tokens_ - Tokens of the header itself, without include directives
+   errors_ - Errors found while lexing the header
+   out_ - Debug output written while lexing the header
+   includes_ - Includes of the header in order
+   guard_ - Include guard of the header
+   error_limit_ - Error limit the header was lexed under
+   generation_ - Generation of the SourceManager every file of includes_
+                 was last found current at
+   built_ - True once the header is lexed, or lexing it threw
+   failed_ - True if lexing it threw, it is never served
+   */
+  struct Entry {
+    Entry(FileID file, size_t block_size, size_t error_limit,
+          uint64_t generation);
+
+    // false if lexing was given up before what limit allows
+    bool isEnoughFor(size_t error_limit) const;
+
+    Arena arena_;
+    TokenStream tokens_;
+    std::vector<CompilerError> errors_;
+    std::string out_;
+    std::vector<Include> includes_;
+    IncludeGuard guard_;
+    size_t error_limit_;
+    uint64_t generation_;
+    bool built_;
+    bool failed_;
+  };
+
+ public:
+  IncludeCache();
+  ~IncludeCache();
+
+ public:
+  // file as lexed with the settings of unit, the first time it is asked for
+  const Entry& get(FileID file, const CompileUnit& unit);
+
+  // entries of stale revisions or including one and retired entries are
+  // freed. no thread may be expanding any entry
+  void evictStale();
+
+ private:
+  /*
+   Key representing what a header lexes differently by
+   file_ - Revision of the header
+   search_ - Search list its includes are resolved with
+   dump_ - Format tokens are dumped in, part of its output
+   */
+  struct Key {
+    bool operator==(const Key& other) const;
+
+    FileID file_;
+    SearchID search_;
+    TokenDump dump_;
+  };
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+
+  // mutex_ is held
+  static bool isCurrent(Entry& entry, uint64_t generation);
+  static void fill(FileID file, const CompileUnit& unit, Entry& entry);
+
+ private:
+  std::unordered_map<Key, std::unique_ptr<Entry>, KeyHash> entries_;
+  std::vector<std::unique_ptr<Entry>> retired_;
+  std::mutex mutex_;
+  std::condition_variable built_;
+};
+#endif  // SRC_INCLUDE_CACHE_H_
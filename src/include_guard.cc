@@ -0,0 +1,97 @@
+#include "include_guard.h"
+
+static bool isIdentifier(const Token& token, SymbolID symbol) {
+  return (token.getTokenKind() == TokenKind::IDENTIFIER) &&
+         (token.getSymbol() == symbol);
+}
+
+IncludeGuard::IncludeGuard()
+    : count_(0),
+      macro_(Token::no_payload),
+      depth_(0),
+      after_pound_(false),
+      after_pragma_(false),
+      closed_(false),
+      broken_(false),
+      pragma_once_(false) {}
+
+IncludeGuard::IncludeGuard(SymbolID macro)
+    : count_(0),
+      macro_(macro),
+      depth_(0),
+      after_pound_(false),
+      after_pragma_(false),
+      closed_(true),
+      broken_(false),
+      pragma_once_(macro == Token::no_payload) {}
+
+void IncludeGuard::feed(const Token& token) {
+  size_t index = count_++;
+  // nothing may follow the #endif of the guard
+  if (closed_) {
+    broken_ = true;
+  }
+
+  // # ifndef X # define X
+  switch (index) {
+    case 0:
+    case 3:
+      broken_ = broken_ || (token.getTokenKind() != TokenKind::SB_POUND);
+      break;
+    case 1:
+      broken_ = broken_ || (!isIdentifier(token, SYM_IFNDEF));
+      break;
+    case 2:
+      if (token.getTokenKind() == TokenKind::IDENTIFIER) {
+        macro_ = token.getSymbol();
+      } else {
+        broken_ = true;
+      }
+      break;
+    case 4:
+      broken_ = broken_ || (!isIdentifier(token, SYM_DEFINE));
+      break;
+    case 5:
+      broken_ = broken_ || (!isIdentifier(token, macro_));
+      break;
+    default:
+      break;
+  }
+
+  if (after_pragma_) {
+    pragma_once_ = pragma_once_ || isIdentifier(token, SYM_ONCE);
+    after_pragma_ = false;
+  }
+  bool directive = after_pound_;
+  after_pound_ = (token.getTokenKind() == TokenKind::SB_POUND);
+  if ((directive) && (!after_pound_)) {
+    feedDirective(token);
+  }
+}
+
+bool IncludeGuard::isOnce() const {
+  return pragma_once_ || ((!broken_) && (closed_));
+}
+
+SymbolID IncludeGuard::getMacro() const {
+  return (pragma_once_) ? (Token::no_payload) : (macro_);
+}
+
+// name of a directive, right after its #
+void IncludeGuard::feedDirective(const Token& token) {
+  if ((token.getTokenKind() == TokenKind::KEY_IF) ||
+      (isIdentifier(token, SYM_IFDEF)) || (isIdentifier(token, SYM_IFNDEF))) {
+    ++depth_;
+  } else if (isIdentifier(token, SYM_ENDIF)) {
+    if (depth_ > 0) {
+      --depth_;
+    }
+    closed_ = (depth_ == 0);
+  } else if ((token.getTokenKind() == TokenKind::KEY_ELSE) ||
+             (isIdentifier(token, SYM_ELIF))) {
+    // the #else of the guard is what a second include sees
+    broken_ = broken_ || (depth_ == 1);
+  } else if (isIdentifier(token, SYM_PRAGMA)) {
+    after_pragma_ = true;
+  }
+}
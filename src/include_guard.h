@@ -0,0 +1,51 @@
+#include <cstddef>
+
+#include "interner.h"
+#include "tokens.h"
+
+#ifndef SRC_INCLUDE_GUARD_H_
+#define SRC_INCLUDE_GUARD_H_
+
+/*
+ IncludeGuard representing what the tokens of a header say about including
+ it more than once: wrapped whole in #ifndef X / #define X ... #endif, or
+ marked with #pragma once
+ count_ - Tokens seen so far
+ macro_ - X of the #ifndef X the header starts with
+ depth_ - Conditionals open, the guard being the outermost
+ after_pound_ - True if the last token was a #
+ after_pragma_ - True if the last tokens were # pragma
+ closed_ - True once the #endif of the guard is seen
+ broken_ - True if the header isn't wrapped whole in the guard
+ pragma_once_ - True if #pragma once is seen
+ */
+class IncludeGuard {
+ public:
+  IncludeGuard();
+  // guard of a header already known to be included once, by macro or by
+  // #pragma once when macro is Token::no_payload
+  explicit IncludeGuard(SymbolID macro);
+
+ public:
+  // every token of the header in order, directives included
+  void feed(const Token& token);
+
+  // true if a second include of the header expands to nothing
+  bool isOnce() const;
+  // X of the guard, Token::no_payload for #pragma once
+  SymbolID getMacro() const;
+
+ private:
+  void feedDirective(const Token& token);
+
+ private:
+  size_t count_;
+  SymbolID macro_;
+  size_t depth_;
+  bool after_pound_;
+  bool after_pragma_;
+  bool closed_;
+  bool broken_;
+  bool pragma_once_;
+};
+#endif  // SRC_INCLUDE_GUARD_H_
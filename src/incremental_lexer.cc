@@ -0,0 +1,218 @@
+#include "incremental_lexer.h"
+
+#include <iostream>
+
+#include "compile_unit.h"
+#include "lexer.h"
+
+// bytes more put before the gap when the lines lexed run past them
+static constexpr size_t relex_step = 4 * 1024;
+
+// items after the gap count from the end, the count doesn't change them
+static uint32_t flip(size_t size, uint32_t value) {
+  return static_cast<uint32_t>(size - value);
+}
+
+static Token flipOffset(size_t size, const Token& token) {
+  return Token(token.getTokenKind(), token.getFileID(),
+               flip(size, token.getOffset()), token.getLength(),
+               token.getSymbol());
+}
+
+IncrementalLexer::IncrementalLexer(FileID file)
+    : file_(file), arena_(), tokens_(), lines_(), relexed_lines_(0) {
+  relex(0, false, 0);
+}
+
+bool IncrementalLexer::edit(uint32_t offset, uint32_t length,
+                            const std::string& text) {
+  size_t size = SourceManager::instance().getBuffer(file_).size();
+  if ((offset > size) || (length > size - offset)) {
+    return false;
+  }
+
+  // bytes before the edit are the same, so is the line it starts in
+  size_t first = findLine(offset, size);
+  moveGap(first, size);
+  uint32_t start = 0;
+  bool in_comment = false;
+  if (lines_.backSize() > 0) {
+    start = flip(size, lines_.firstBack().offset_);
+    in_comment = lines_.firstBack().in_comment_;
+  }
+
+  if (!SourceManager::instance().editBuffer(file_, offset, length, text)) {
+    return false;
+  }
+  relex(start, in_comment, offset + static_cast<uint32_t>(text.size()));
+  return true;
+}
+
+size_t IncrementalLexer::getTokenCount() const { return tokens_.size(); }
+
+Token IncrementalLexer::getToken(size_t index) const {
+  if (index < tokens_.frontSize()) {
+    return tokens_[index];
+  }
+  size_t size = SourceManager::instance().getBuffer(file_).size();
+  return flipOffset(size, tokens_[index]);
+}
+
+std::vector<CompilerError> IncrementalLexer::getErrors() {
+  size_t size = SourceManager::instance().getBuffer(file_).size();
+  std::vector<CompilerError> errors;
+  std::ostream discard(nullptr);
+  CompileUnit unit{arena_, errors, discard, TokenDump::NONE, 0, nullptr,
+                   nullptr, nullptr, nullptr, 0, 0};
+  for (size_t index = 0; index < lines_.size(); ++index) {
+    LineState line = getLine(index, size);
+    if (!line.reported_) {
+      continue;
+    }
+    arena_.reset();
+    Lexer lexer(file_, unit);
+    lexer.cursor_ = lexer.begin_ + line.offset_;
+    lexer.in_comment_ = line.in_comment_;
+    lexer.nextLine();
+    lexer.tokenizeCurrentLine();
+  }
+  arena_.reset();
+  return errors;
+}
+
+size_t IncrementalLexer::getRelexedLines() const { return relexed_lines_; }
+
+// last line starting at or before offset
+size_t IncrementalLexer::findLine(uint32_t offset, size_t size) const {
+  size_t low = 0;
+  size_t high = lines_.size();
+  while (high - low > 1) {
+    size_t middle = low + (high - low) / 2;
+    if (getLine(middle, size).offset_ <= offset) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+IncrementalLexer::LineState IncrementalLexer::getLine(size_t index,
+                                                      size_t size) const {
+  LineState line = lines_[index];
+  if (index >= lines_.frontSize()) {
+    line.offset_ = flip(size, line.offset_);
+    line.token_ = flip(tokens_.size(), line.token_);
+  }
+  return line;
+}
+
+// first offset from offset on a logical line starts at, or the end
+size_t IncrementalLexer::findLineEnd(const SourceBuffer& buffer,
+                                     size_t offset) {
+  size_t size = buffer.size();
+  while ((offset > 0) && (offset < size) &&
+         ((buffer.at(offset - 1) != '\n') ||
+          ((offset > 1) && (buffer.at(offset - 2) == '\\')))) {
+    ++offset;
+  }
+  return offset;
+}
+
+// put the gap before line, and before its first token
+void IncrementalLexer::moveGap(size_t line, size_t size) {
+  size_t count = tokens_.size();
+  while (lines_.frontSize() > line) {
+    LineState moved = lines_.lastFront();
+    moved.offset_ = flip(size, moved.offset_);
+    moved.token_ = flip(count, moved.token_);
+    lines_.moveToBack(moved);
+  }
+  while (lines_.frontSize() < line) {
+    LineState moved = lines_.firstBack();
+    moved.offset_ = flip(size, moved.offset_);
+    moved.token_ = flip(count, moved.token_);
+    lines_.moveToFront(moved);
+  }
+
+  size_t token = (lines_.backSize() > 0)
+                     ? (flip(count, lines_.firstBack().token_))
+                     : (count);
+  while (tokens_.frontSize() > token) {
+    tokens_.moveToBack(flipOffset(size, tokens_.lastFront()));
+  }
+  while (tokens_.frontSize() < token) {
+    tokens_.moveToFront(flipOffset(size, tokens_.firstBack()));
+  }
+}
+
+// lex lines from start into the gap, dropping the old lines after it until
+// one past edit_end starts where a new one does. the bytes are lexed in
+// place, only those up to the line lexed last are put before the gap of the
+// buffer
+void IncrementalLexer::relex(uint32_t start, bool in_comment,
+                             uint32_t edit_end) {
+  const SourceBuffer& buffer = SourceManager::instance().getBuffer(file_);
+  size_t size = buffer.size();
+  size_t lexable = findLineEnd(buffer, edit_end);
+  const char* begin = buffer.prefix(lexable);
+
+  arena_.reset();
+  std::vector<CompilerError> errors;
+  std::ostream discard(nullptr);
+  CompileUnit unit{arena_, errors, discard, TokenDump::NONE, 0, nullptr,
+                   nullptr, nullptr, nullptr, 0, 0};
+  Lexer lexer(file_, begin, begin + lexable, unit);
+  lexer.cursor_ = begin + start;
+  lexer.in_comment_ = in_comment;
+
+  relexed_lines_ = 0;
+  bool resynced = false;
+  for (;;) {
+    uint32_t offset = static_cast<uint32_t>(lexer.cursor_ - lexer.begin_);
+    if (offset >= edit_end) {
+      // old lines starting before offset are gone, one starting at it
+      // lexes the same from here on when it starts in the same state
+      while ((lines_.backSize() > 0) &&
+             (flip(size, lines_.firstBack().offset_) < offset)) {
+        lines_.dropBack(1);
+      }
+      if ((lines_.backSize() > 0) &&
+          (flip(size, lines_.firstBack().offset_) == offset) &&
+          (lines_.firstBack().in_comment_ == lexer.in_comment_)) {
+        resynced = true;
+        break;
+      }
+    }
+
+    // more lines are wanted, the buffer doesn't move with its gap
+    if ((lexer.cursor_ == lexer.end_) && (lexable < size)) {
+      lexable = findLineEnd(buffer, std::min(lexable + relex_step, size));
+      lexer.end_ = buffer.prefix(lexable) + lexable;
+    }
+
+    bool line_in_comment = lexer.in_comment_;
+    if (!lexer.nextLine()) {
+      break;
+    }
+    size_t error_count = errors.size();
+    bool ok = lexer.tokenizeCurrentLine();
+    lines_.pushFront({offset, static_cast<uint32_t>(tokens_.frontSize()),
+                      line_in_comment, ok, errors.size() > error_count});
+    if (ok) {
+      for (const auto& token : lexer.line_tokens_) {
+        tokens_.pushFront(token);
+      }
+    }
+    ++relexed_lines_;
+  }
+
+  // tokens of the old lines dropped go with them
+  if (resynced) {
+    tokens_.dropBack(tokens_.backSize() - lines_.firstBack().token_);
+  } else {
+    lines_.dropBack(lines_.backSize());
+    tokens_.dropBack(tokens_.backSize());
+  }
+  arena_.reset();
+}
@@ -0,0 +1,72 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "errors.h"
+#include "gap_vector.h"
+#include "source_buffer.h"
+#include "source_manager.h"
+#include "tokens.h"
+
+#ifndef SRC_INCREMENTAL_LEXER_H_
+#define SRC_INCREMENTAL_LEXER_H_
+
+/*
+ IncrementalLexer representing the tokens of a buffer being edited, kept up
+ to date by relexing from the start of the logical line an edit is in until
+ a line starts where an old one did, in the same comment state. Tokens and
+ lines are held in gap buffers with the gap at the last edit: those after
+ it count their offsets from the end of the buffer and their token index
+ from the last token, so an edit doesn't move them
+ file_ - Buffer edited, an in-memory file of the SourceManager
+ arena_ - Scratch memory of the lexer relexing an edit
+ tokens_ - Tokens of the buffer in order, lines with errors left out
+ lines_ - Every logical line of the buffer in order
+ relexed_lines_ - Lines lexed by the last edit
+ */
+class IncrementalLexer {
+ public:
+  explicit IncrementalLexer(FileID file);
+
+ public:
+  // replace length bytes at offset by text, false if they aren't in it
+  bool edit(uint32_t offset, uint32_t length, const std::string& text);
+
+  size_t getTokenCount() const;
+  Token getToken(size_t index) const;
+  // errors of the lines that reported any, lexed again to report them
+  std::vector<CompilerError> getErrors();
+  size_t getRelexedLines() const;
+
+ private:
+  /*
+   LineState representing what lexing a logical line starts from
+   offset_ - Offset of the first byte of the line
+   token_ - Index of the first token of the line
+   in_comment_ - True if the line starts inside a block comment
+   ok_ - False if the line has an error and no tokens
+   reported_ - True if lexing the line reported errors, with tokens or not
+   */
+  struct LineState {
+    uint32_t offset_;
+    uint32_t token_;
+    bool in_comment_;
+    bool ok_;
+    bool reported_;
+  };
+
+  static size_t findLineEnd(const SourceBuffer& buffer, size_t offset);
+  size_t findLine(uint32_t offset, size_t size) const;
+  LineState getLine(size_t index, size_t size) const;
+  void moveGap(size_t line, size_t size);
+  void relex(uint32_t start, bool in_comment, uint32_t edit_end);
+
+ private:
+  FileID file_;
+  Arena arena_;
+  GapVector<Token> tokens_;
+  GapVector<LineState> lines_;
+  size_t relexed_lines_;
+};
+#endif  // SRC_INCREMENTAL_LEXER_H_
@@ -0,0 +1,150 @@
+#include "interner.h"
+
+#include <cstring>
+
+#include "errors.h"
+
+static const char* const well_known_symbols[]{
+    "include", "define", "undef",  "ifdef", "ifndef", "elif",
+    "endif",   "pragma", "once",   "error", "line",   "defined"};
+
+static constexpr size_t initial_slot_count = 256;
+static constexpr size_t block_size = 64 * 1024;
+static constexpr size_t chunk_bits = 16;
+static constexpr size_t chunk_size = size_t(1) << chunk_bits;
+static constexpr size_t chunk_count = 32 * 1024;
+// SymbolID max is no_payload of a Token, it is never handed out
+static constexpr size_t max_symbol_count = chunk_size * chunk_count;
+
+constexpr size_t Interner::stripe_bits;
+constexpr size_t Interner::stripe_count;
+
+// FNV-1a
+static uint32_t symbolHash(boost::string_ref text) {
+  uint32_t hash = 2166136261u;
+  for (char c : text) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+  }
+  return hash;
+}
+
+Interner::Interner()
+    : chunks_(new std::atomic<SymbolEntry*>[chunk_count]), next_id_(0) {
+  for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+    chunks_[chunk].store(nullptr, std::memory_order_relaxed);
+  }
+  for (auto& stripe : stripes_) {
+    stripe.slots_.assign(initial_slot_count, 0);
+    stripe.count_ = 0;
+    stripe.block_cursor_ = nullptr;
+    stripe.block_left_ = 0;
+  }
+  for (const char* name : well_known_symbols) {
+    intern(name);
+  }
+}
+
+Interner::~Interner() {
+  for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+    delete[] chunks_[chunk].load(std::memory_order_relaxed);
+  }
+}
+
+Interner& Interner::instance() {
+  static Interner interner;
+  return interner;
+}
+
+SymbolID Interner::intern(boost::string_ref text) {
+  uint32_t hash = symbolHash(text);
+  // the low bits of the hash pick the slot, the top ones the stripe
+  Stripe& stripe = stripes_[hash >> (32 - stripe_bits)];
+  std::lock_guard<std::mutex> lock(stripe.mutex_);
+
+  size_t mask = stripe.slots_.size() - 1;
+  size_t slot = hash & mask;
+  while (stripe.slots_[slot] != 0) {
+    const SymbolEntry& entry = entryOf(stripe.slots_[slot] - 1);
+    if ((entry.hash_ == hash) && (entry.length_ == text.size()) &&
+        (memcmp(entry.text_, text.data(), text.size()) == 0)) {
+      return stripe.slots_[slot] - 1;
+    }
+    slot = (slot + 1) & mask;
+  }
+
+  SymbolID id = next_id_.fetch_add(1);
+  if (id >= max_symbol_count) {
+    throw CompilerError(DiagID::TOO_MANY_SYMBOLS);
+  }
+
+  SymbolEntry& entry = entryOf(id);
+  entry.text_ = store(stripe, text);
+  entry.length_ = static_cast<uint32_t>(text.size());
+  entry.hash_ = hash;
+  stripe.slots_[slot] = id + 1;
+  // keep the table at most half full
+  if (++stripe.count_ * 2 > stripe.slots_.size()) {
+    grow(stripe);
+  }
+  return id;
+}
+
+boost::string_ref Interner::getText(SymbolID id) const {
+  const SymbolEntry* chunk =
+      chunks_[id >> chunk_bits].load(std::memory_order_acquire);
+  const SymbolEntry& entry = chunk[id & (chunk_size - 1)];
+  return boost::string_ref(entry.text_, entry.length_);
+}
+
+size_t Interner::size() const { return next_id_.load(); }
+
+Interner::SymbolEntry& Interner::entryOf(SymbolID id) {
+  std::atomic<SymbolEntry*>& slot = chunks_[id >> chunk_bits];
+  SymbolEntry* chunk = slot.load(std::memory_order_acquire);
+  if (chunk == nullptr) {
+    // stripes race for a new chunk, the loser frees its copy
+    SymbolEntry* fresh = new SymbolEntry[chunk_size];
+    if (slot.compare_exchange_strong(chunk, fresh,
+                                     std::memory_order_acq_rel)) {
+      chunk = fresh;
+    } else {
+      delete[] fresh;
+    }
+  }
+  return chunk[id & (chunk_size - 1)];
+}
+
+const char* Interner::store(Stripe& stripe, boost::string_ref text) {
+  if (text.empty()) {
+    return "";
+  }
+  if (text.size() > stripe.block_left_) {
+    // a text longer than a block gets a block of its own
+    size_t size = (text.size() > block_size) ? (text.size()) : (block_size);
+    stripe.blocks_.emplace_back(new char[size]);
+    stripe.block_cursor_ = stripe.blocks_.back().get();
+    stripe.block_left_ = size;
+  }
+
+  char* stored = stripe.block_cursor_;
+  memcpy(stored, text.data(), text.size());
+  stripe.block_cursor_ += text.size();
+  stripe.block_left_ -= text.size();
+  return stored;
+}
+
+void Interner::grow(Stripe& stripe) {
+  std::vector<uint32_t> slots(stripe.slots_.size() * 2, 0);
+  size_t mask = slots.size() - 1;
+  for (uint32_t id_plus_one : stripe.slots_) {
+    if (id_plus_one == 0) {
+      continue;
+    }
+    size_t slot = entryOf(id_plus_one - 1).hash_ & mask;
+    while (slots[slot] != 0) {
+      slot = (slot + 1) & mask;
+    }
+    slots[slot] = id_plus_one;
+  }
+  stripe.slots_.swap(slots);
+}
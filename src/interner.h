@@ -0,0 +1,91 @@
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/utility/string_ref.hpp>
+
+#ifndef SRC_INTERNER_H_
+#define SRC_INTERNER_H_
+
+using SymbolID = uint32_t;
+
+// names interned before anything else, in the order of well_known_symbols
+constexpr SymbolID SYM_INCLUDE = 0;
+constexpr SymbolID SYM_DEFINE = 1;
+constexpr SymbolID SYM_UNDEF = 2;
+constexpr SymbolID SYM_IFDEF = 3;
+constexpr SymbolID SYM_IFNDEF = 4;
+constexpr SymbolID SYM_ELIF = 5;
+constexpr SymbolID SYM_ENDIF = 6;
+constexpr SymbolID SYM_PRAGMA = 7;
+constexpr SymbolID SYM_ONCE = 8;
+constexpr SymbolID SYM_ERROR = 9;
+constexpr SymbolID SYM_LINE = 10;
+constexpr SymbolID SYM_DEFINED = 11;
+
+/*
+ Interner representing every identifier and string value seen by the
+ compiler, each stored once and named by a SymbolID. Safe to use from
+ several threads: texts are spread over stripes by hash, each with its own
+ lock, while ids come from one counter
+ stripes_ - Hash tables and arenas, selected by the top bits of the hash
+ chunks_ - Entries indexed by SymbolID in fixed chunks that never move, so
+           reading a text takes no lock
+ next_id_ - Next SymbolID to hand out
+ */
+class Interner {
+ public:
+  static Interner& instance();
+
+ public:
+  SymbolID intern(boost::string_ref text);
+  boost::string_ref getText(SymbolID id) const;
+  size_t size() const;
+
+ private:
+  Interner();
+  ~Interner();
+
+  /*
+   SymbolEntry representing one interned text
+   text_, length_ - Bytes of the text in the arena of its stripe
+   hash_ - Hash of the text, kept to rehash without reading it again
+   */
+  struct SymbolEntry {
+    const char* text_;
+    uint32_t length_;
+    uint32_t hash_;
+  };
+
+  /*
+   Stripe representing the symbols whose hash selects it
+   mutex_ - Guards everything else in the stripe
+   slots_ - Open-addressing hash table of SymbolID + 1, 0 for an empty slot
+   count_ - Number of symbols in the stripe
+   blocks_ - Arena the texts are copied into, never moved once written
+   block_cursor_, block_left_ - Free bytes at the end of the last block
+   */
+  struct Stripe {
+    std::mutex mutex_;
+    std::vector<uint32_t> slots_;
+    size_t count_;
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char* block_cursor_;
+    size_t block_left_;
+  };
+
+  SymbolEntry& entryOf(SymbolID id);
+  const char* store(Stripe& stripe, boost::string_ref text);
+  void grow(Stripe& stripe);
+
+ private:
+  static constexpr size_t stripe_bits = 4;
+  static constexpr size_t stripe_count = size_t(1) << stripe_bits;
+
+  Stripe stripes_[stripe_count];
+  std::unique_ptr<std::atomic<SymbolEntry*>[]> chunks_;
+  std::atomic<uint32_t> next_id_;
+};
+#endif  // SRC_INTERNER_H_
@@ -1,101 +1,362 @@
 #include "lexer.h"
 
-#include <cctype>
-
 #include <algorithm>
+#include <condition_variable>
+#include <cstring>
 #include <iostream>
-#include <sstream>
+#include <mutex>
 #include <unordered_map>
-#include <unordered_set>
-
-Lexer::Lexer(const std::vector<char>& buffer, const std::string& filename,
-             bool need_lexer)
-    : buffer_(buffer), filename_(filename), need_lexer_(need_lexer) {}
-
-void Lexer::tokenize(std::vector<Token>& tokens,
-                     std::vector<CompilerError>& errors) {
-  std::vector<std::vector<Tagged>> taggedlines;
-  splitToTagged(taggedlines);
-  joinExtendedLine(taggedlines);
-
-  size_t count = 0;
-  bool in_comment = false;
-  if (need_lexer_) {
-    std::cout << "----- ----- < " << filename_ << " tokens > ----- -----"
-              << std::endl;
-  }
-  for (const auto& taggedline : taggedlines) {
-    try {
-      std::vector<Token> linetokens;
-      tokenizeLine(taggedline, in_comment, linetokens, errors);
-      // only for debug
-      if (need_lexer_) {
-        std::for_each(linetokens.begin(), linetokens.end(),
-                      [&count](const Token& tk) {
-                        std::cout << "    [" << count << "]" << tk << std::endl;
-                      });
+
+#include "char_class.h"
+#include "interner.h"
+#include "scan.h"
+#include "thread_pool.h"
+
+// tokens the lookahead holds before it has to grow
+static constexpr size_t initial_lookahead_size = 16;
+// smallest and biggest chunk a file is cut into when lexed in parallel
+static constexpr size_t min_chunk_size = 256 * 1024;
+static constexpr size_t max_chunk_size = 1024 * 1024;
+
+Lexer::Lexer(FileID file, CompileUnit& unit)
+    : Lexer(file, SourceManager::instance().getBuffer(file).begin(),
+            SourceManager::instance().getBuffer(file).end(), unit) {}
+
+Lexer::Lexer(FileID file, const char* begin, const char* end,
+             CompileUnit& unit)
+    : file_(file),
+      begin_(begin),
+      end_(end),
+      cursor_(begin_),
+      line_(begin_),
+      line_size_(0),
+      line_offset_(0),
+      spliced_(ArenaAllocator<char>(unit.arena_)),
+      splices_(ArenaAllocator<Splice>(unit.arena_)),
+      splice_hint_(0),
+      in_comment_(false),
+      line_count_(0),
+      line_tokens_(ArenaAllocator<Token>(unit.arena_)),
+      lookahead_(initial_lookahead_size, Token(),
+                 ArenaAllocator<Token>(unit.arena_)),
+      lookahead_head_(0),
+      lookahead_count_(0),
+      started_(false),
+      finished_(false),
+      dump_(unit.dump_, unit.out_),
+      lexed_ahead_(false),
+      lexed_chunks_(),
+      lexed_chunk_(0),
+      lexed_line_(0),
+      lexed_token_(0),
+      lexed_error_(0),
+      unit_(unit) {}
+
+bool Lexer::next(Token& token) {
+  if (!fillLookahead(1)) {
+    return false;
+  }
+  token = lookahead_[lookahead_head_];
+  lookahead_head_ = (lookahead_head_ + 1) & (lookahead_.size() - 1);
+  --lookahead_count_;
+  return true;
+}
+
+bool Lexer::peek(size_t n, Token& token) {
+  if (!fillLookahead(n + 1)) {
+    return false;
+  }
+  token = lookahead_[(lookahead_head_ + n) & (lookahead_.size() - 1)];
+  return true;
+}
+
+void Lexer::flushDump() { dump_.flush(); }
+
+void Lexer::tokenize(TokenStream& tokens) {
+  Token token;
+  while (next(token)) {
+    tokens.push(token);
+  }
+}
+
+bool Lexer::fillLookahead(size_t count) {
+  while (lookahead_count_ < count) {
+    if (!lexLine()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Lexer::lexLine() {
+  if (!started_) {
+    dump_.beginFile(file_);
+    size_t size = end_ - begin_;
+    if ((unit_.parallel_lex_size_ > 0) && (unit_.lex_pool_ != nullptr) &&
+        (size >= unit_.parallel_lex_size_)) {
+      lexAhead();
+    }
+  }
+  started_ = true;
+
+  // a file with too many errors ends there
+  bool lexed = (unit_.getErrorRoom() > 0) &&
+               ((lexed_ahead_) ? (takeLexedLine()) : (lexNextLine()));
+  if (!lexed) {
+    if (!finished_) {
+      dump_.endFile(file_);
+      dump_.flush();
+    }
+    finished_ = true;
+    return false;
+  }
+  return true;
+}
+
+bool Lexer::lexNextLine() {
+  if (!nextLine()) {
+    return false;
+  }
+  if (tokenizeCurrentLine()) {
+    emitLine(line_tokens_.data(), line_tokens_.data() + line_tokens_.size());
+  }
+  return true;
+}
+
+bool Lexer::tokenizeCurrentLine() {
+  line_tokens_.clear();
+  try {
+    tokenizeLine(in_comment_, line_tokens_);
+  } catch (const CompilerError& e) {
+    // a line with an error contributes no tokens
+    unit_.errors_.push_back(e);
+    return false;
+  }
+  return true;
+}
+
+void Lexer::emitLine(const Token* first, const Token* last) {
+  for (const Token* token = first; token < last; ++token) {
+    dump_.write(*token, line_count_);
+    pushLookahead(*token);
+  }
+  ++line_count_;
+}
+
+bool Lexer::lexAhead() {
+  if (cursor_ >= end_) {
+    return false;
+  }
+  size_t threads = unit_.lex_pool_->size();
+  size_t chunk_size =
+      std::min(std::max(static_cast<size_t>(end_ - begin_) / (threads * 4),
+                        min_chunk_size),
+               max_chunk_size);
+
+  // cut after a newline that doesn't continue the line, so every chunk
+  // starts a logical line and only the comment state is carried over. a
+  // window of a chunk per thread is lexed at a time, the next one once
+  // this one is handed out
+  std::vector<const char*> bounds{cursor_};
+  while ((bounds.back() < end_) && (bounds.size() <= threads)) {
+    const char* cut = bounds.back() + chunk_size;
+    while (cut < end_) {
+      cut = static_cast<const char*>(memchr(cut, '\n', end_ - cut));
+      if (cut == nullptr) {
+        cut = end_;
+      } else if (*(cut - 1) != '\\') {
+        ++cut;
+        break;
+      } else {
+        ++cut;
       }
+    }
+    bounds.push_back(std::min(cut, end_));
+  }
 
-      tokens.insert(tokens.end(), linetokens.begin(), linetokens.end());
-      ++count;
-    } catch (const CompilerError& e) {
-      errors.push_back(e);
+  // both guesses for every chunk but the first, which starts in the state
+  // the window before ended in
+  size_t chunk_count = bounds.size() - 1;
+  std::vector<LexedChunk> guesses(chunk_count * 2);
+  std::vector<size_t> lexed;
+  for (size_t guess = 0; guess < guesses.size(); ++guess) {
+    if ((guess > 1) || ((guess == 1) == in_comment_)) {
+      lexed.push_back(guess);
     }
   }
-  if (need_lexer_) {
-    std::cout << "----- ----- ----- < "
-              << " > ----- ----- -----" << std::endl;
+
+  // other files lex on the same pool, only these guesses are waited for
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t pending = lexed.size();
+  for (size_t guess : lexed) {
+    unit_.lex_pool_->submit([this, guess, &bounds, &guesses, &mutex, &done,
+                             &pending](size_t) {
+      lexChunk(bounds[guess / 2], bounds[guess / 2 + 1], (guess % 2) == 1,
+               guesses[guess]);
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--pending == 0) {
+        done.notify_all();
+      }
+    });
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&pending] { return pending == 0; });
   }
+
+  // the real state at the start of a chunk is where the previous one ended
+  lexed_chunks_.clear();
+  lexed_chunk_ = 0;
+  lexed_line_ = 0;
+  lexed_token_ = 0;
+  lexed_error_ = 0;
+  cursor_ = bounds.back();
+  for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+    LexedChunk& picked = guesses[chunk * 2 + (in_comment_ ? 1 : 0)];
+    in_comment_ = picked.in_comment_;
+    bool stopped = picked.stopped_;
+    lexed_chunks_.push_back(std::move(picked));
+    if (stopped) {
+      cursor_ = end_;
+      break;
+    }
+  }
+  lexed_ahead_ = true;
+  return true;
 }
 
-void Lexer::splitToTagged(std::vector<std::vector<Tagged>>& taggedlines) {
-  std::stringstream ss;
-  std::for_each(buffer_.begin(), buffer_.end(), [&ss](char c) { ss << c; });
+void Lexer::lexChunk(const char* begin, const char* end, bool in_comment,
+                     LexedChunk& chunk) const {
+  Arena arena;
+  std::ostream discard(nullptr);
+  CompileUnit unit{arena, chunk.errors_, discard, TokenDump::NONE, 0,
+                   nullptr, nullptr, nullptr, nullptr, 0, unit_.error_limit_};
+  Lexer lexer(file_, unit);
+  lexer.cursor_ = begin;
+  lexer.end_ = end;
+  lexer.in_comment_ = in_comment;
 
-  for (std::string line; std::getline(ss, line);) {
-    // for debug
-    // std::cout << "[" << taggedlines.size() << "]" << line << std::endl;
+  while (lexer.nextLine()) {
+    bool ok = lexer.tokenizeCurrentLine();
+    if (ok) {
+      chunk.tokens_.insert(chunk.tokens_.end(), lexer.line_tokens_.begin(),
+                           lexer.line_tokens_.end());
+    }
+    chunk.lines_.push_back({chunk.tokens_.size(), chunk.errors_.size(), ok});
+    // the file is given up before the end of the chunk is reached
+    if (unit.getErrorRoom() == 0) {
+      chunk.stopped_ = true;
+      break;
+    }
+  }
+  chunk.in_comment_ = lexer.in_comment_;
+}
 
-    std::vector<Tagged> taggedline;
-    for (const auto& c : line) {
-      Position p(filename_, taggedlines.size() + 1, taggedline.size() + 1,
-                 line);
-      taggedline.push_back(Tagged(c, p));
+bool Lexer::takeLexedLine() {
+  for (;;) {
+    while ((lexed_chunk_ < lexed_chunks_.size()) &&
+           (lexed_line_ == lexed_chunks_[lexed_chunk_].lines_.size())) {
+      ++lexed_chunk_;
+      lexed_line_ = 0;
+      lexed_token_ = 0;
+      lexed_error_ = 0;
+    }
+    if (lexed_chunk_ < lexed_chunks_.size()) {
+      break;
+    }
+    if (!lexAhead()) {
+      return false;
     }
-    taggedlines.push_back(taggedline);
   }
+
+  const LexedChunk& chunk = lexed_chunks_[lexed_chunk_];
+  const LexedLine& line = chunk.lines_[lexed_line_++];
+  size_t error_count =
+      std::min(line.error_end_ - lexed_error_, unit_.getErrorRoom());
+  unit_.errors_.insert(unit_.errors_.end(),
+                       chunk.errors_.begin() + lexed_error_,
+                       chunk.errors_.begin() + lexed_error_ + error_count);
+  if (line.ok_) {
+    emitLine(chunk.tokens_.data() + lexed_token_,
+             chunk.tokens_.data() + line.token_end_);
+  }
+  lexed_token_ = line.token_end_;
+  lexed_error_ = line.error_end_;
+  return true;
 }
 
-void Lexer::joinExtendedLine(std::vector<std::vector<Tagged>>& taggedlines) {
-  for (size_t i = 0; i < taggedlines.size(); i++) {
-    if ((taggedlines[i].size() > 0) &&
-        (taggedlines[i][taggedlines[i].size() - 1].getC() == '\\')) {
-      if (i + 1 < taggedlines.size()) {
-        taggedlines[i].pop_back();
-        taggedlines[i].insert(taggedlines[i].end(), taggedlines[i + 1].begin(),
-                              taggedlines[i + 1].end());
-        taggedlines.erase(taggedlines.begin() + i + 1);
-        --i;
-      } else {
-        taggedlines.erase(taggedlines.begin() + i);
+void Lexer::pushLookahead(const Token& token) {
+  if (lookahead_count_ == lookahead_.size()) {
+    // unroll the ring into a buffer twice as big
+    std::rotate(lookahead_.begin(), lookahead_.begin() + lookahead_head_,
+                lookahead_.end());
+    lookahead_.resize(lookahead_.size() * 2);
+    lookahead_head_ = 0;
+  }
+  lookahead_[(lookahead_head_ + lookahead_count_) & (lookahead_.size() - 1)] =
+      token;
+  ++lookahead_count_;
+}
+
+bool Lexer::nextLine() {
+  spliced_.clear();
+  splices_.clear();
+  splice_hint_ = 0;
+
+  bool splicing = false;
+  while (cursor_ < end_) {
+    const char* line_begin = cursor_;
+    const char* line_end =
+        static_cast<const char*>(memchr(line_begin, '\n', end_ - line_begin));
+    line_end = (line_end != nullptr) ? (line_end) : (end_);
+    cursor_ = (line_end < end_) ? (line_end + 1) : (end_);
+
+    bool continued = (line_begin < line_end) && (*(line_end - 1) == '\\');
+    if (continued) {
+      // the last line can't be continued, it is dropped
+      if (cursor_ >= end_) {
+        break;
       }
+      --line_end;
+    }
+
+    if ((!continued) && (!splicing)) {
+      line_ = line_begin;
+      line_size_ = line_end - line_begin;
+      line_offset_ = static_cast<uint32_t>(line_begin - begin_);
+      return true;
+    }
+
+    // join continued lines, remembering where every piece came from
+    splicing = true;
+    splices_.push_back({static_cast<uint32_t>(spliced_.size()),
+                        static_cast<uint32_t>(line_begin - begin_)});
+    spliced_.append(line_begin, line_end);
+
+    if (!continued) {
+      line_ = spliced_.data();
+      line_size_ = spliced_.size();
+      line_offset_ = 0;
+      return true;
     }
   }
+
+  return false;
 }
 
-void Lexer::tokenizeLine(const std::vector<Tagged>& taggedline,
-                         bool& in_comment, std::vector<Token>& linetokens,
-                         std::vector<CompilerError>& errors) {
+void Lexer::tokenizeLine(bool& in_comment, ArenaVector<Token>& linetokens) {
+  const char* line_end = line_ + line_size_;
   size_t chunk_start = 0;
   size_t chunk_end = 0;
 
   bool include_line = false;
   bool seen_filename = false;
 
-  while (chunk_end < taggedline.size()) {
-    TokenPair symbol_kind = Token::findSymbolKind(taggedline, chunk_end);
-    TokenPair next_symbol_kind =
-        Token::findSymbolKind(taggedline, chunk_end + 1);
+  while (chunk_end < line_size_) {
+    char c = line_[chunk_end];
+    char next_c =
+        (chunk_end + 1 < line_size_) ? (line_[chunk_end + 1]) : ('\0');
 
     if (matchIncludeCommand(linetokens)) {
       include_line = true;
@@ -103,265 +364,243 @@ void Lexer::tokenizeLine(const std::vector<Tagged>& taggedline,
 
     // end comment
     if (in_comment) {
-      if ((symbol_kind.first == TokenKind::SB_MUL) &&
-          (next_symbol_kind.first == TokenKind::SB_DIV)) {
+      const char* comment_end = findCommentEnd(line_ + chunk_end, line_end);
+      if (comment_end < line_end) {
         in_comment = false;
-        chunk_start = chunk_end + 2;
-        chunk_end = chunk_start;
+        chunk_start = comment_end + 2 - line_;
       } else {
-        chunk_start = chunk_end + 1;
-        chunk_end = chunk_start;
+        chunk_start = line_size_;
       }
+      chunk_end = chunk_start;
     }
     // begin comment
-    else if ((symbol_kind.first == TokenKind::SB_DIV) &&
-             (next_symbol_kind.first == TokenKind::SB_MUL)) {
-      chunkToToken(taggedline, chunk_start, chunk_end, linetokens);
+    else if ((c == '/') && (next_c == '*')) {
+      chunkToToken(chunk_start, chunk_end, linetokens);
       in_comment = true;
+      chunk_start = chunk_end + 2;
+      chunk_end = chunk_start;
     }
     // single comment
-    else if ((symbol_kind.first == TokenKind::SB_DIV) &&
-             (next_symbol_kind.first == TokenKind::SB_DIV)) {
+    else if ((c == '/') && (next_c == '/')) {
       break;
     }
     // skip blank
-    else if (isblank(taggedline[chunk_end].getC())) {
-      chunkToToken(taggedline, chunk_start, chunk_end, linetokens);
-      chunk_start = chunk_end + 1;
+    else if (isBlankChar(c)) {
+      chunkToToken(chunk_start, chunk_end, linetokens);
+      chunk_start = isBlankChar(next_c)
+                        ? (skipBlanks(line_ + chunk_end + 2, line_end) - line_)
+                        : (chunk_end + 1);
       chunk_end = chunk_start;
     }
     // include line
     else if (include_line) {
       if (seen_filename) {
-        throw CompilerError(
-            "extra tokens at end of include directive",
-            std::make_shared<Range>(taggedline[chunk_end].getRange().getBegin(),
-                                    taggedline[chunk_end].getRange().getEnd()));
+        throw CompilerError(DiagID::EXTRA_INCLUDE_TOKENS,
+                            rangeOf(chunk_end, chunk_end));
       }
 
       std::pair<std::string, size_t> read_result =
-          readIncludeFilename(taggedline, chunk_end);
+          readIncludeFilename(chunk_end);
       linetokens.push_back(
-          Token(TokenKind::INCLUDE, read_result.first, "",
-                std::make_shared<Range>(
-                    taggedline[chunk_end].getPosition(),
-                    taggedline[read_result.second].getPosition())));
+          makeToken(TokenKind::INCLUDE, chunk_end, read_result.second));
       chunk_start = read_result.second + 1;
       chunk_end = chunk_start;
       seen_filename = true;
     }
     // string
-    else if ((symbol_kind.first == TokenKind::SB_DQUOTE) ||
-             (symbol_kind.first == TokenKind::SB_SQUOTE)) {
-      char quote;
-      TokenKind kind;
-      // bool add_null;
-      if (symbol_kind.first == TokenKind::SB_DQUOTE) {
-        quote = '\"';
-        kind = TokenKind::STRING;
-        // add_null = true;
-      } else {
-        quote = '\'';
-        kind = TokenKind::CHAR;
-        // add_null = false;
-      }
+    else if ((c == '\"') || (c == '\'')) {
+      char quote = c;
+      TokenKind kind =
+          (quote == '\"') ? (TokenKind::STRING) : (TokenKind::CHAR);
       std::pair<std::string, size_t> read_result =
-          readString(taggedline, chunk_end + 1, quote);
-      std::string rep = "";
-      for (size_t index = chunk_end; index < read_result.second + 1; ++index) {
-        rep += std::string(1, taggedline[index].getC());
-      }
-      std::shared_ptr<Range> range =
-          std::make_shared<Range>(taggedline[chunk_end].getPosition(),
-                                  taggedline[read_result.second].getPosition());
+          readString(chunk_end + 1, quote);
+      Range range = rangeOf(chunk_end, read_result.second);
       if ((kind == TokenKind::CHAR) && (read_result.first.size() == 0)) {
-        errors.push_back(CompilerError("empty character constant", range));
+        unit_.errors_.push_back(
+            CompilerError(DiagID::EMPTY_CHAR, range));
       } else if ((kind == TokenKind::CHAR) && (read_result.first.size() > 1)) {
-        errors.push_back(
-            CompilerError("multiple characters in character constant", range));
+        unit_.errors_.push_back(
+            CompilerError(DiagID::MULTI_CHAR, range));
       }
-      linetokens.push_back(Token(kind, read_result.first, rep, range));
+      uint32_t offset = range.getBegin().getOffset();
+      uint32_t length = range.getEnd().getOffset() + 1 - offset;
+      uint32_t payload = Interner::instance().intern(read_result.first);
+      linetokens.push_back(Token(kind, file_, offset, length, payload));
       chunk_start = read_result.second + 1;
       chunk_end = chunk_start;
-    } else if (symbol_kind.first != TokenKind::NOT_A_KIND) {
-      size_t symbol_start_index = chunk_end;
-      size_t symbol_end_index = chunk_end + symbol_kind.second.size() - 1;
-
-      Token symbol_token = Token(
-          symbol_kind.first, "", "",
-          std::make_shared<Range>(taggedline[symbol_start_index].getPosition(),
-                                  taggedline[symbol_end_index].getPosition()));
-      chunkToToken(taggedline, chunk_start, chunk_end, linetokens);
-      linetokens.push_back(symbol_token);
-
-      chunk_start = chunk_end + symbol_kind.second.size();
-      chunk_end = chunk_start;
-    } else {
-      ++chunk_end;
+    }
+    // run of identifier or number bytes in a chunk
+    else if (isIdentChar(c)) {
+      chunk_end = skipIdentChars(line_ + chunk_end, line_end) - line_;
+    }
+    // symbol or part of a chunk
+    else {
+      TokenKind symbol_kind;
+      size_t symbol_length =
+          Token::matchSymbol(line_ + chunk_end, line_end, symbol_kind);
+      if (symbol_length > 0) {
+        chunkToToken(chunk_start, chunk_end, linetokens);
+        linetokens.push_back(makeToken(symbol_kind, chunk_end,
+                                       chunk_end + symbol_length - 1));
+
+        chunk_start = chunk_end + symbol_length;
+        chunk_end = chunk_start;
+      } else {
+        ++chunk_end;
+      }
     }
   }
 
-  chunkToToken(taggedline, chunk_start, chunk_end, linetokens);
+  chunkToToken(chunk_start, chunk_end, linetokens);
   if (((include_line) || (matchIncludeCommand(linetokens))) &&
       (!seen_filename)) {
-    readIncludeFilename(taggedline, chunk_end);
+    readIncludeFilename(chunk_end);
   }
 }
 
-bool Lexer::matchIncludeCommand(const std::vector<Token>& linetokens) {
+bool Lexer::matchIncludeCommand(const ArenaVector<Token>& linetokens) {
   return (linetokens.size() == 2) &&
          (linetokens[0].getTokenKind() == TokenKind::SB_POUND) &&
          (linetokens[1].getTokenKind() == TokenKind::IDENTIFIER) &&
-         (!linetokens[1].getContent().compare("include"));
+         (linetokens[1].getSymbol() == SYM_INCLUDE);
 }
 
-void Lexer::chunkToToken(const std::vector<Tagged>& taggedline,
-                         size_t chunk_start, size_t chunk_end,
-                         std::vector<Token>& linetokens) {
+void Lexer::chunkToToken(size_t chunk_start, size_t chunk_end,
+                         ArenaVector<Token>& linetokens) {
   if (chunk_start < chunk_end) {
-    std::shared_ptr<Range> range =
-        std::make_shared<Range>(taggedline[chunk_start].getPosition(),
-                                taggedline[chunk_end - 1].getPosition());
-    TokenPair keyword_kind =
-        Token::findKeyWordKind(taggedline, chunk_start, chunk_end);
-    if (keyword_kind.first != TokenKind::NOT_A_KIND) {
-      linetokens.push_back(
-          Token(keyword_kind.first, keyword_kind.second, "", range));
-      return;
-    }
-
-    std::string number = Token::findNumber(taggedline, chunk_start, chunk_end);
-    if (number.compare("")) {
-      linetokens.push_back(Token(TokenKind::NUMBER, number, "", range));
-      return;
-    }
-
-    std::string identifier =
-        Token::findIdentifier(taggedline, chunk_start, chunk_end);
-    if (identifier.compare("")) {
-      linetokens.push_back(Token(TokenKind::IDENTIFIER, identifier, "", range));
-      return;
-    }
-
-    std::string unreg_chunk = "";
-    for (; chunk_start < chunk_end; ++chunk_start) {
-      unreg_chunk += std::string(1, taggedline[chunk_start].getC());
+    const char* chunk_begin = line_ + chunk_start;
+    const char* chunk_stop = line_ + chunk_end;
+    TokenKind kind = Token::findKeyWordKind(chunk_begin, chunk_stop);
+    if (kind == TokenKind::NOT_A_KIND) {
+      if (Token::isNumber(chunk_begin, chunk_stop)) {
+        kind = TokenKind::NUMBER;
+      } else if (Token::isIdentifier(chunk_begin, chunk_stop)) {
+        kind = TokenKind::IDENTIFIER;
+      } else {
+        throw CompilerError(DiagID::UNRECOGNIZED_TOKEN,
+                            rangeOf(chunk_start, chunk_end - 1));
+      }
     }
-    // std::string unreg_chunk = "";
-    // std::getline(ss, unreg_chunk);
-    throw CompilerError("unrecognized token at " + unreg_chunk, range);
+    linetokens.push_back(makeToken(kind, chunk_start, chunk_end - 1));
   }
 }
 
-std::pair<std::string, size_t> Lexer::readIncludeFilename(
-    const std::vector<Tagged>& taggedline, size_t start_index) {
+std::pair<std::string, size_t> Lexer::readIncludeFilename(size_t start_index) {
   char end_flag;
-  if ((start_index < taggedline.size()) &&
-      (taggedline[start_index].getC() == '\"')) {
+  if ((start_index < line_size_) && (line_[start_index] == '\"')) {
     end_flag = '\"';
-  } else if ((start_index < taggedline.size()) &&
-             (taggedline[start_index].getC() == '<')) {
+  } else if ((start_index < line_size_) && (line_[start_index] == '<')) {
     end_flag = '>';
   } else {
-    size_t tgi;
-
-    if (start_index < taggedline.size()) {
-      tgi = start_index;
-    } else {
-      tgi = taggedline.size() - 1;
-    }
-
-    throw CompilerError(
-        "expected \"FILENAME\" or <FILENAME> after include directive",
-        std::make_shared<Range>(taggedline[tgi].getPosition(),
-                                taggedline[tgi].getPosition()));
+    size_t index =
+        (start_index < line_size_) ? (start_index) : (line_size_ - 1);
+    throw CompilerError(DiagID::EXPECTED_INCLUDE_FILENAME,
+                        rangeOf(index, index));
   }
 
-  size_t index = start_index + 1;
-  try {
-    while (taggedline[index].getC() != end_flag) {
-      ++index;
-    }
-  } catch (const std::exception& e) {
-    throw CompilerError(
-        "missing terminating character for include filename",
-        std::make_shared<Range>(taggedline[start_index].getPosition(),
-                                taggedline[start_index].getPosition()));
+  const char* filename_end = std::find(line_ + start_index + 1,
+                                       line_ + line_size_, end_flag);
+  if (filename_end == line_ + line_size_) {
+    throw CompilerError(DiagID::UNTERMINATED_INCLUDE_FILENAME,
+                        rangeOf(start_index, start_index));
   }
 
-  std::string includename = "";
-  for (; start_index < index + 1; ++start_index) {
-    includename += std::string(1, taggedline[start_index].getC());
-  }
-  return {includename, index};
+  size_t index = filename_end - line_;
+  return {std::string(line_ + start_index, filename_end + 1), index};
 }
 
-std::pair<std::string, size_t> Lexer::readString(
-    const std::vector<Tagged>& taggedline, size_t start_index, char delim) {
+std::pair<std::string, size_t> Lexer::readString(size_t start_index,
+                                                 char delim) {
   size_t index = start_index;
   std::string str;
   static const std::unordered_map<char, size_t> escapes{
       {'\'', 39}, {'\"', 34}, {'?', 63}, {'\\', 92}, {'a', 7}, {'b', 8},
       {'f', 12},  {'n', 10},  {'r', 13}, {'t', 9},   {'v', 11}};
-  static const std::unordered_set<char> octdigits{'0', '1', '2', '3',
-                                                  '4', '5', '6', '7'};
-  static const std::unordered_set<char> hexdigits = {
-      '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a',
-      'b', 'c', 'd', 'e', 'f', 'A', 'B', 'C', 'D', 'E', 'F'};
 
   while (true) {
-    if (index >= taggedline.size()) {
-      throw CompilerError(
-          "missing terminating quote",
-          std::make_shared<Range>(taggedline[start_index].getPosition(),
-                                  taggedline[start_index].getPosition()));
-    } else if (taggedline[index].getC() == delim) {
+    if (index >= line_size_) {
+      throw CompilerError(DiagID::MISSING_QUOTE,
+                          rangeOf(start_index, start_index));
+    } else if (line_[index] == delim) {
       return {str, index};
-    } else if (((index + 1) < taggedline.size()) &&
-               (taggedline[index].getC() == '\\') &&
-               (escapes.find(taggedline[index + 1].getC()) != escapes.end())) {
-      str += std::string(
-          1, static_cast<char>(escapes.at(taggedline[index + 1].getC())));
+    } else if (((index + 1) < line_size_) && (line_[index] == '\\') &&
+               (escapes.find(line_[index + 1]) != escapes.end())) {
+      str += std::string(1, static_cast<char>(escapes.at(line_[index + 1])));
       index += 2;
-    } else if ((index + 1 < taggedline.size()) &&
-               (taggedline[index].getC() == '\\') &&
-               (octdigits.find(taggedline[index + 1].getC()) !=
-                octdigits.end())) {
+    } else if ((index + 1 < line_size_) && (line_[index] == '\\') &&
+               (isOctDigitChar(line_[index + 1]))) {
       size_t octol_size = 1;
-      size_t octal = taggedline[index + 1].getC() - '0';
+      size_t octal = line_[index + 1] - '0';
       index += 2;
-      while ((index < taggedline.size()) && (octol_size < 3) &&
-             (octdigits.find(taggedline[index].getC()) != octdigits.end())) {
-        octal = octal * 8 + (taggedline[index].getC() - '0');
+      while ((index < line_size_) && (octol_size < 3) &&
+             (isOctDigitChar(line_[index]))) {
+        octal = octal * 8 + (line_[index] - '0');
         ++index;
         ++octol_size;
       }
       str += std::string(1, static_cast<char>(octal));
-    } else if ((index + 2 < taggedline.size()) &&
-               (taggedline[index].getC() == '\\') &&
-               (taggedline[index + 1].getC() == 'x') &&
-               (hexdigits.find(taggedline[index + 2].getC()) !=
-                hexdigits.end())) {
-      size_t hexa = 0;
-      if (isdigit(taggedline[index + 2].getC())) {
-        hexa = taggedline[index + 2].getC() - '0';
-      } else {
-        hexa = tolower(taggedline[index + 2].getC()) - 'a' + 10;
-      }
+    } else if ((index + 2 < line_size_) && (line_[index] == '\\') &&
+               (line_[index + 1] == 'x') &&
+               (isHexDigitChar(line_[index + 2]))) {
+      size_t hexa = hexDigitValue(line_[index + 2]);
       index += 3;
-      while ((index < taggedline.size()) &&
-             (hexdigits.find(taggedline[index].getC()) != hexdigits.end())) {
-        if (isdigit(taggedline[index].getC())) {
-          hexa = hexa * 16 + taggedline[index].getC() - '0';
-        } else {
-          hexa = hexa * 16 + tolower(taggedline[index].getC()) - 'a' + 10;
-        }
+      while ((index < line_size_) && (isHexDigitChar(line_[index]))) {
+        hexa = hexa * 16 + hexDigitValue(line_[index]);
         ++index;
       }
       str += std::string(1, static_cast<char>(hexa));
-    } else {
-      str += std::string(1, static_cast<char>(taggedline[index].getC()));
+    } else if (line_[index] == '\\') {
+      str += line_[index];
       ++index;
+    } else {
+      const char* run_end =
+          findStringSpecial(line_ + index, line_ + line_size_, delim);
+      str.append(line_ + index, run_end);
+      index = run_end - line_;
     }
   }
-}
\ No newline at end of file
+}
+
+Position Lexer::positionAt(size_t index) const {
+  // the end of a line reports its last byte
+  if ((index >= line_size_) && (line_size_ > 0)) {
+    index = line_size_ - 1;
+  }
+  if (splices_.empty()) {
+    return Position(file_, line_offset_ + static_cast<uint32_t>(index));
+  }
+  // the piece holding index is the last one starting at or before it, tokens
+  // come in order so it is mostly the last piece used or one after it
+  if (index < splices_[splice_hint_].start_) {
+    auto piece = std::upper_bound(
+        splices_.begin(), splices_.end(), index,
+        [](size_t i, const Splice& splice) { return i < splice.start_; });
+    splice_hint_ = static_cast<size_t>(piece - splices_.begin()) - 1;
+  }
+  while ((splice_hint_ + 1 < splices_.size()) &&
+         (splices_[splice_hint_ + 1].start_ <= index)) {
+    ++splice_hint_;
+  }
+  const Splice& piece = splices_[splice_hint_];
+  uint32_t distance = static_cast<uint32_t>(index - piece.start_);
+  return Position(file_, piece.offset_ + distance);
+}
+
+Token Lexer::makeToken(TokenKind kind, size_t first, size_t last) const {
+  uint32_t offset = positionAt(first).getOffset();
+  uint32_t length = positionAt(last).getOffset() + 1 - offset;
+  boost::string_ref spelling(line_ + first, last + 1 - first);
+  uint32_t payload = Token::no_payload;
+  if (kind == TokenKind::IDENTIFIER) {
+    payload = Interner::instance().intern(spelling);
+  }
+  // a token split by a line splice can't be read back from the source
+  else if (length != spelling.size()) {
+    payload = Interner::instance().intern(spelling);
+  }
+  return Token(kind, file_, offset, length, payload);
+}
+
+Range Lexer::rangeOf(size_t first, size_t last) const {
+  return Range(positionAt(first), positionAt(last));
+}
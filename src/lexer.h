@@ -1,37 +1,163 @@
+#include <cstdint>
+#include <string>
 #include <utility>
 #include <vector>
 
+#include "arena.h"
+#include "compile_unit.h"
 #include "errors.h"
+#include "source_manager.h"
+#include "token_dump.h"
+#include "token_stream.h"
 #include "tokens.h"
 
 #ifndef SRC_LEXER_H_
 #define SRC_LEXER_H_
 
+/*
+ Lexer representing a cursor over the bytes of one source file, tokens are
+ lexed a line at a time as they are pulled
+ file_ - File being lexed
+ begin_, end_ - Read-only view of the bytes owned by the SourceManager
+ cursor_ - Start of the next physical line to read
+ line_, line_size_ - Current logical line
+ line_offset_ - Offset of line_[0] in the file when the line isn't spliced
+ spliced_ - Logical line joined from backslash-continued physical lines
+ splices_ - Where every physical piece of spliced_ starts, in it and in the
+            file
+ splice_hint_ - Piece the last position was found in
+ in_comment_ - True while inside a block comment spanning lines
+ line_count_ - Number of logical lines lexed without error, for the dump
+ line_tokens_ - Tokens of the line being lexed
+ lookahead_ - Ring buffer of lexed tokens not pulled yet, its size a power
+              of two
+ lookahead_head_, lookahead_count_ - First pulled token and count in it
+ started_, finished_ - True once the dump header or footer is written
+ dump_ - Tokens printed as they are lexed
+ lexed_ahead_ - True if the file is lexed in parallel chunks, a window of
+                them at a time so memory stays bounded
+ lexed_chunks_ - Chunks of the window lexed ahead, from the comment state
+                 they really start in
+ lexed_chunk_, lexed_line_, lexed_token_, lexed_error_ - Next chunk, and
+                 next line, token and error in it, to hand out
+ unit_ - File being compiled, for its arena, errors and output
+ */
 class Lexer {
  public:
-  Lexer(const std::vector<char>& buffer, const std::string& filename,
-        bool need_lexer);
+  // bumped whenever a change of the lexer or of the tokens makes some file
+  // lex differently, tokens cached by earlier runs are keyed by it
+  static constexpr uint32_t version = 1;
 
  public:
-  void tokenize(std::vector<Token>& tokens, std::vector<CompilerError>& errors);
+  Lexer(FileID file, CompileUnit& unit);
+
+ public:
+  // next token of the file, false at its end
+  bool next(Token& token);
+  // token n after the next one without pulling it, false past the end
+  bool peek(size_t n, Token& token);
+  // pull every remaining token
+  void tokenize(TokenStream& tokens);
+  // print the tokens lexed so far, before anything else is written to the
+  // output of the file
+  void flushDump();
 
  private:
-  void splitToTagged(std::vector<std::vector<Tagged>>& taggedlines);
-  void joinExtendedLine(std::vector<std::vector<Tagged>>& taggedlines);
-  void tokenizeLine(const std::vector<Tagged>& taggedline, bool& in_comment,
-                    std::vector<Token>& linetokens,
-                    std::vector<CompilerError>& errors);
-  bool matchIncludeCommand(const std::vector<Token>& linetokens);
-  void chunkToToken(const std::vector<Tagged>& taggedline, size_t chunk_start,
-                    size_t chunk_end, std::vector<Token>& linetokens);
-  std::pair<std::string, size_t> readIncludeFilename(
-      const std::vector<Tagged>& taggedline, size_t start_index);
-  std::pair<std::string, size_t> readString(
-      const std::vector<Tagged>& taggedline, size_t start_index, char delim);
+  friend class IncrementalLexer;
+
+  // lexer of the bytes [begin, end) of file, offsets counted from begin
+  Lexer(FileID file, const char* begin, const char* end, CompileUnit& unit);
+
+  /*
+   LexedLine representing a logical line lexed ahead
+   token_end_, error_end_ - End of its tokens and errors in the chunk
+   ok_ - False if the line had an error and contributes no tokens
+   */
+  struct LexedLine {
+    size_t token_end_;
+    size_t error_end_;
+    bool ok_;
+  };
+
+  /*
+   Splice representing a physical line joined into a logical line, the bytes
+   of a piece map one to one to the file
+   start_ - Index in spliced_ of its first byte
+   offset_ - Offset of that byte in the file
+   */
+  struct Splice {
+    uint32_t start_;
+    uint32_t offset_;
+  };
+
+  /*
+   LexedChunk representing whole lines lexed ahead from a guessed comment
+   state, the guess is checked once the chunk before it is known
+   tokens_, errors_, lines_ - What lexing the lines produced
+   in_comment_ - True if the chunk ends inside a block comment
+   stopped_ - True if the chunk ran into the error limit before its end
+   */
+  struct LexedChunk {
+    std::vector<Token> tokens_;
+    std::vector<CompilerError> errors_;
+    std::vector<LexedLine> lines_;
+    bool in_comment_ = false;
+    bool stopped_ = false;
+  };
+
+  bool fillLookahead(size_t count);
+  bool lexLine();
+  bool lexNextLine();
+  bool tokenizeCurrentLine();
+  void emitLine(const Token* first, const Token* last);
+  void pushLookahead(const Token& token);
+
+  // lex the next window of a big file in chunks on every core, false at
+  // the end of the file
+  bool lexAhead();
+  void lexChunk(const char* begin, const char* end, bool in_comment,
+                LexedChunk& chunk) const;
+  bool takeLexedLine();
+
+  bool nextLine();
+  void tokenizeLine(bool& in_comment, ArenaVector<Token>& linetokens);
+  bool matchIncludeCommand(const ArenaVector<Token>& linetokens);
+  void chunkToToken(size_t chunk_start, size_t chunk_end,
+                    ArenaVector<Token>& linetokens);
+  std::pair<std::string, size_t> readIncludeFilename(size_t start_index);
+  std::pair<std::string, size_t> readString(size_t start_index, char delim);
+
+  // token of the line bytes [first, last]
+  Token makeToken(TokenKind kind, size_t first, size_t last) const;
+  Position positionAt(size_t index) const;
+  Range rangeOf(size_t first, size_t last) const;
 
  private:
-  std::vector<char> buffer_;
-  std::string filename_;
-  bool need_lexer_;
+  FileID file_;
+  const char* begin_;
+  const char* end_;
+  const char* cursor_;
+  const char* line_;
+  size_t line_size_;
+  uint32_t line_offset_;
+  ArenaString spliced_;
+  ArenaVector<Splice> splices_;
+  mutable size_t splice_hint_;
+  bool in_comment_;
+  size_t line_count_;
+  ArenaVector<Token> line_tokens_;
+  ArenaVector<Token> lookahead_;
+  size_t lookahead_head_;
+  size_t lookahead_count_;
+  bool started_;
+  bool finished_;
+  TokenWriter dump_;
+  bool lexed_ahead_;
+  std::vector<LexedChunk> lexed_chunks_;
+  size_t lexed_chunk_;
+  size_t lexed_line_;
+  size_t lexed_token_;
+  size_t lexed_error_;
+  CompileUnit& unit_;
 };
 #endif  // SRC_LEXER_H_
@@ -1,7 +1,31 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
 #include "aycc.h"
+#include "compile_server.h"
 
 int main(int argc, char** argv) {
-  Aycc aycc(argc, argv);
-  aycc.run();
+  // --server PATH stays resident, --connect PATH ... forwards the rest to it
+  if ((argc == 3) && (std::string(argv[1]) == "--server")) {
+    return (CompileServer(argv[2]).serve()) ? (0) : (1);
+  }
+  std::vector<char*> args(argv, argv + argc);
+  if ((argc >= 3) && (std::string(argv[1]) == "--connect")) {
+    args.erase(args.begin() + 1, args.begin() + 3);
+    int status;
+    if (CompileServer::forward(argv[2], static_cast<int>(args.size()),
+                               args.data(), status)) {
+      return status;
+    }
+  }
+
+  try {
+    Aycc aycc(static_cast<int>(args.size()), args.data());
+    aycc.run();
+  } catch (const CompilerError& e) {
+    std::cerr << e << std::endl;
+    return 1;
+  }
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,92 @@
+#include "output_buffer.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+// text gathered before it is written out
+static constexpr size_t block_size = 64 * 1024;
+
+OutputBuffer::OutputBuffer(std::ostream& out)
+    : out_(&out), fd_(-1), block_(block_size), failed_(false) {
+  setp(block_.data(), block_.data() + block_.size());
+}
+
+OutputBuffer::OutputBuffer(int fd)
+    : out_(nullptr), fd_(fd), block_(block_size), failed_(false) {
+  setp(block_.data(), block_.data() + block_.size());
+}
+
+OutputBuffer::~OutputBuffer() { flush(); }
+
+void OutputBuffer::append(boost::string_ref text) {
+  xsputn(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+void OutputBuffer::append(char c) { sputc(c); }
+
+bool OutputBuffer::flush() {
+  writeBlock();
+  if (out_ != nullptr) {
+    out_->flush();
+    failed_ = (failed_) || (!*out_);
+  }
+  return !failed_;
+}
+
+OutputBuffer::int_type OutputBuffer::overflow(int_type c) {
+  writeBlock();
+  if (!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+std::streamsize OutputBuffer::xsputn(const char* text, std::streamsize size) {
+  size_t length = static_cast<size_t>(size);
+  if (length <= static_cast<size_t>(epptr() - pptr())) {
+    std::copy(text, text + length, pptr());
+    pbump(static_cast<int>(length));
+    return size;
+  }
+  writeBlock();
+  if (length >= block_.size()) {
+    writeOut(text, length);
+  } else {
+    std::copy(text, text + length, pptr());
+    pbump(static_cast<int>(length));
+  }
+  return size;
+}
+
+int OutputBuffer::sync() { return (flush()) ? (0) : (-1); }
+
+void OutputBuffer::writeOut(const char* text, size_t size) {
+  if (failed_) {
+    return;
+  }
+  if (out_ != nullptr) {
+    out_->write(text, static_cast<std::streamsize>(size));
+    failed_ = !*out_;
+    return;
+  }
+  while (size > 0) {
+    ssize_t n = ::write(fd_, text, size);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      failed_ = true;
+      return;
+    }
+    text += n;
+    size -= static_cast<size_t>(n);
+  }
+}
+
+void OutputBuffer::writeBlock() {
+  writeOut(pbase(), static_cast<size_t>(pptr() - pbase()));
+  setp(block_.data(), block_.data() + block_.size());
+}
@@ -0,0 +1,51 @@
+#include <iostream>
+#include <streambuf>
+#include <vector>
+
+#include <boost/utility/string_ref.hpp>
+
+#ifndef SRC_OUTPUT_BUFFER_H_
+#define SRC_OUTPUT_BUFFER_H_
+
+/*
+ OutputBuffer representing text gathered in memory and written to a file
+ descriptor or a stream a block at a time, instead of being flushed line by
+ line. Text as big as a block goes straight through. Wrap it in an
+ std::ostream to print to it with <<
+ out_ - Stream written to, nullptr when writing to fd_
+ fd_ - File descriptor written to, -1 when writing to out_
+ block_ - Put area of text not written yet
+ failed_ - True once a write failed, the rest is dropped
+ */
+class OutputBuffer : public std::streambuf {
+ public:
+  explicit OutputBuffer(std::ostream& out);
+  explicit OutputBuffer(int fd);
+  ~OutputBuffer();
+
+  OutputBuffer(const OutputBuffer&) = delete;
+  OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+ public:
+  void append(boost::string_ref text);
+  void append(char c);
+  // write out what is gathered and flush the stream, false if any write
+  // failed
+  bool flush();
+
+ protected:
+  int_type overflow(int_type c) override;
+  std::streamsize xsputn(const char* text, std::streamsize size) override;
+  int sync() override;
+
+ private:
+  void writeOut(const char* text, size_t size);
+  void writeBlock();
+
+ private:
+  std::ostream* out_;
+  int fd_;
+  std::vector<char> block_;
+  bool failed_;
+};
+#endif  // SRC_OUTPUT_BUFFER_H_
@@ -1,18 +1,175 @@
 #include "para_init.h"
 
-ParaInit::ParaInit(int argc, char** argv) : parser_(argc, argv) {
+#include <thread>
+
+static std::vector<char*> argvOf(std::vector<std::string>& args) {
+  std::vector<char*> argv;
+  for (auto& arg : args) {
+    argv.push_back(&arg[0]);
+  }
+  argv.push_back(nullptr);
+  return argv;
+}
+
+ParaInit::ParaInit(int argc, char** argv)
+    : args_(splitArgs(argc, argv)),
+      argv_(argvOf(args_)),
+      parser_(static_cast<int>(args_.size()), argv_.data()),
+      dir_(),
+      valid_(true) {
   parserInit();
   parser_.run_and_exit_if_error();
 }
 
+ParaInit::ParaInit(int argc, char** argv, const std::string& dir,
+                   std::ostream& out)
+    : args_(splitArgs(argc, argv)),
+      argv_(argvOf(args_)),
+      parser_(static_cast<int>(args_.size()), argv_.data()),
+      dir_(dir),
+      valid_(false) {
+  // --help would exit the server
+  parser_.disable_help();
+  parserInit();
+  valid_ = parser_.run(out, out);
+}
+
+bool ParaInit::isValid() const { return valid_; }
+
+std::vector<std::string> ParaInit::splitArgs(int argc, char** argv) {
+  std::vector<std::string> args;
+  for (int index = 0; index < argc; ++index) {
+    std::string arg(argv[index]);
+    size_t flag = 0;
+    if ((index > 0) && (arg.compare(0, 8, "-isystem") == 0)) {
+      flag = 8;
+    } else if ((index > 0) && (arg.compare(0, 2, "-I") == 0)) {
+      flag = 2;
+    } else if ((index > 0) && (arg.compare(0, 1, "-") == 0) &&
+               (arg.find('=') != std::string::npos)) {
+      flag = arg.find('=');
+    }
+
+    if ((flag == 0) || (arg.size() == flag)) {
+      args.push_back(arg);
+      continue;
+    }
+    args.push_back(arg.substr(0, flag));
+    // the = of -option=value goes
+    args.push_back(arg.substr((arg[flag] == '=') ? (flag + 1) : (flag)));
+  }
+  return args;
+}
+
 void ParaInit::parserInit() {
   parser_.set_optional<bool>("l", "lexer", false, "Need print lexer result");
+  parser_.set_optional<std::string>(
+      "dt", "dump-tokens", "",
+      "Print the tokens of every file as text, jsonl or bin, -l is text");
+  parser_.set_optional<std::string>(
+      "df", "dump-file", "",
+      "File the tokens are printed to instead of the standard output");
+  parser_.set_optional<bool>("s", "stats", false,
+                             "Need print allocator statistics");
+  parser_.set_optional<int>(
+      "j", "jobs", static_cast<int>(std::thread::hardware_concurrency()),
+      "Number of files compiled in parallel");
+  parser_.set_optional<int>(
+      "pl", "parallel-lex", 0,
+      "Lex files of at least this many KB in parallel chunks, 0 for never");
+  parser_.set_optional<std::string>(
+      "tc", "token-cache", "",
+      "Directory keeping lexed headers for later runs, empty for none");
+  parser_.set_optional<std::string>(
+      "inc", "incremental", "",
+      "File recording what objects were built from, to skip unchanged files "
+      "on later runs, empty for none");
+  parser_.set_optional<bool>("MD", "write-deps", false,
+                             "Write the make rule of every object to a .d "
+                             "file next to it");
+  parser_.set_optional<std::string>(
+      "MF", "deps-file", "",
+      "Write the make rules of every object to this file instead");
+  parser_.set_optional<std::vector<std::string>>(
+      "I", "include-dir", {},
+      "Directories searched for included files, in order");
+  parser_.set_optional<std::vector<std::string>>(
+      "isystem", "system-include-dir", {},
+      "Directories searched for included files after the -I ones");
+  parser_.set_optional<int>(
+      "ferror-limit", "error-limit", 20,
+      "Errors after which the rest of a file is given up, 0 for no limit");
   parser_.set_required<std::vector<std::string>>("f", "files",
                                                  "Input files [.c] or [.o]");
 }
 
 std::vector<std::string> ParaInit::getFiles() {
-  return parser_.get<std::vector<std::string>>("f");
+  return resolvePaths(parser_.get<std::vector<std::string>>("f"));
+}
+
+bool ParaInit::needLexer() { return parser_.get<bool>("l"); }
+
+std::string ParaInit::getTokenDump() {
+  std::string format = parser_.get<std::string>("dt");
+  return ((format.empty()) && (needLexer())) ? ("text") : (format);
+}
+
+std::string ParaInit::getDumpFile() {
+  return resolvePath(parser_.get<std::string>("df"));
+}
+
+bool ParaInit::needStats() { return parser_.get<bool>("s"); }
+
+size_t ParaInit::getJobs() {
+  // hardware_concurrency is 0 when it can't be told
+  int jobs = parser_.get<int>("j");
+  return (jobs > 0) ? (static_cast<size_t>(jobs)) : (1);
 }
 
-bool ParaInit::needLexer() { return parser_.get<bool>("l"); }
\ No newline at end of file
+size_t ParaInit::getParallelLexSize() {
+  int kilobytes = parser_.get<int>("pl");
+  return (kilobytes > 0) ? (static_cast<size_t>(kilobytes) * 1024) : (0);
+}
+
+std::string ParaInit::getTokenCacheDir() {
+  return resolvePath(parser_.get<std::string>("tc"));
+}
+
+std::string ParaInit::getManifestPath() {
+  return resolvePath(parser_.get<std::string>("inc"));
+}
+
+bool ParaInit::needDepfile() { return parser_.get<bool>("MD"); }
+
+std::string ParaInit::getDepfilePath() {
+  return resolvePath(parser_.get<std::string>("MF"));
+}
+
+std::vector<std::string> ParaInit::getIncludeDirs() {
+  return resolvePaths(parser_.get<std::vector<std::string>>("I"));
+}
+
+std::vector<std::string> ParaInit::getSystemIncludeDirs() {
+  return resolvePaths(parser_.get<std::vector<std::string>>("isystem"));
+}
+
+size_t ParaInit::getErrorLimit() {
+  int limit = parser_.get<int>("ferror-limit");
+  return (limit > 0) ? (static_cast<size_t>(limit)) : (0);
+}
+
+// empty paths stay empty, they mean none
+std::string ParaInit::resolvePath(const std::string& path) const {
+  if ((dir_.empty()) || (path.empty()) || (path[0] == '/')) {
+    return path;
+  }
+  return dir_ + '/' + path;
+}
+
+std::vector<std::string> ParaInit::resolvePaths(
+    std::vector<std::string> paths) const {
+  for (auto& path : paths) {
+    path = resolvePath(path);
+  }
+  return paths;
+}
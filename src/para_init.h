@@ -6,15 +6,44 @@
 class ParaInit {
  public:
   ParaInit(int argc, char** argv);
+  // options of a request to the compile server, usage and errors are
+  // written to out instead of exiting. relative paths are taken from dir,
+  // the working directory of the client
+  ParaInit(int argc, char** argv, const std::string& dir, std::ostream& out);
 
  public:
+  bool isValid() const;
+
   std::vector<std::string> getFiles();
   bool needLexer();
+  // name of the format tokens are printed in, empty for none
+  std::string getTokenDump();
+  std::string getDumpFile();
+  bool needStats();
+  size_t getJobs();
+  size_t getParallelLexSize();
+  std::string getTokenCacheDir();
+  std::string getManifestPath();
+  bool needDepfile();
+  std::string getDepfilePath();
+  std::vector<std::string> getIncludeDirs();
+  std::vector<std::string> getSystemIncludeDirs();
+  size_t getErrorLimit();
 
  private:
+  // -Idir, -isystemdir and -option=value as two arguments each, the parser
+  // wants them so
+  static std::vector<std::string> splitArgs(int argc, char** argv);
   void parserInit();
+  std::string resolvePath(const std::string& path) const;
+  std::vector<std::string> resolvePaths(std::vector<std::string> paths) const;
 
  private:
+  std::vector<std::string> args_;
+  std::vector<char*> argv_;
   cli::Parser parser_;
+  // directory relative paths are taken from, empty for the working one
+  std::string dir_;
+  bool valid_;
 };
 #endif  // SRC_PARA_INIT_
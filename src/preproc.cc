@@ -1,82 +1,331 @@
 #include "preproc.h"
 
-#include <fstream>
+#include <algorithm>
+#include <iterator>
+#include <sstream>
 
 #include <boost/filesystem.hpp>
 
-PreProc::PreProc(const std::string& filename, bool need_lexer)
-    : filename_(filename), need_lexer_(need_lexer) {}
-
-void PreProc::retokenize(std::vector<Token>& tokens,
-                         std::vector<CompilerError>& errors) {
-  size_t index = 0;
-  std::vector<Token> processed;
-  for (; index < tokens.size() - 2;) {
-    if ((tokens[index].getTokenKind() == TokenKind::SB_POUND) &&
-        (tokens[index + 1].getTokenKind() == TokenKind::IDENTIFIER) &&
-        (!tokens[index + 1].getContent().compare("include")) &&
-        (tokens[index + 2].getTokenKind() == TokenKind::INCLUDE)) {
-      try {
-        std::vector<char> includefilebuffer;
-        std::string includefilepath =
-            readInludeFile(tokens[index + 2].getContent(), includefilebuffer);
-
-        std::vector<Token> includetokens;
-        Lexer includelexer(includefilebuffer, includefilepath, need_lexer_);
-        includelexer.tokenize(includetokens, errors);
-
-        PreProc preproc(includefilepath, need_lexer_);
-        preproc.retokenize(includetokens, errors);
-
-        processed.insert(processed.end(), includetokens.begin(),
-                         includetokens.end());
-      } catch (std::exception& ec) {
-        errors.push_back(CompilerError("unable to read included file",
-                                       tokens[index + 2].getRange()));
+#include "header_search.h"
+#include "interner.h"
+
+// most tokens lexed into one segment before it is handed out
+static constexpr size_t max_lexed_segment_size = 256;
+
+PreProc::PreProc(FileID file, CompileUnit& unit)
+    : sources_(),
+      once_(),
+      resolved_(),
+      undef_state_(0),
+      checked_errors_(0),
+      failed_(false),
+      included_(),
+      included_set_(),
+      lexed_(file, unit.arena_),
+      current_{nullptr, 0, 0},
+      unit_(unit) {
+  pushLexed(file);
+}
+
+bool PreProc::next(Segment& segment) {
+  if (current_.first_ < current_.last_) {
+    segment = current_;
+    current_.first_ = current_.last_;
+    return true;
+  }
+  return pull(segment);
+}
+
+bool PreProc::next(Token& token) {
+  if ((current_.first_ == current_.last_) && (!pull(current_))) {
+    return false;
+  }
+  token = (*current_.tokens_)[current_.first_++];
+  return true;
+}
+
+const std::vector<FileID>& PreProc::getIncludedFiles() const {
+  return included_;
+}
+
+void PreProc::lexHeader(FileID file, const CompileUnit& unit,
+                        IncludeCache::Entry& entry) {
+  std::ostringstream out;
+  CompileUnit header{entry.arena_, entry.errors_, out, unit.dump_,
+                     unit.parallel_lex_size_, unit.lex_pool_, unit.includes_,
+                     unit.token_cache_, unit.include_counts_, unit.search_,
+                     unit.error_limit_};
+  Lexer lexer(file, header);
+  std::string dir = getDir(file);
+  Token token;
+  while (lexer.next(token)) {
+    entry.guard_.feed(token);
+    Token command, filename;
+    if (!matchInclude(lexer, token, command, filename)) {
+      entry.tokens_.push(token);
+      continue;
+    }
+    entry.guard_.feed(command);
+    entry.guard_.feed(filename);
+
+    FileID includefile;
+    std::string includepath;
+    // the path and the output of the header go after the tokens before it
+    lexer.flushDump();
+    try {
+      includefile = readInludeFile(dir, filename.getContent().to_string(),
+                                   header, includepath);
+    } catch (std::exception& ec) {
+      entry.errors_.push_back(
+          CompilerError(DiagID::UNREADABLE_INCLUDE, filename.getRange()));
+      continue;
+    }
+    noteInclude(includepath, header);
+    entry.includes_.push_back({entry.tokens_.size(), entry.errors_.size(),
+                               static_cast<size_t>(out.tellp()), includefile,
+                               filename});
+  }
+  entry.out_ = out.str();
+}
+
+bool PreProc::pull(Segment& segment) {
+  while (!sources_.empty()) {
+    // a file with too many errors isn't worth expanding further
+    if (unit_.getErrorRoom() == 0) {
+      sources_.clear();
+      break;
+    }
+    Source& source = sources_.back();
+    bool pulled = (source.lexer_) ? (pullLexed(source, segment))
+                                  : (pullCached(source, segment));
+    if (pulled) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// tokens of the file up to its next include, false when there were none
+bool PreProc::pullLexed(Source& source, Segment& segment) {
+  Lexer& lexer = *source.lexer_;
+  lexed_.truncate(0);
+  Token token;
+  while (lexed_.size() < max_lexed_segment_size) {
+    if (!lexer.next(token)) {
+      popLexed();
+      break;
+    }
+
+    source.guard_.feed(token);
+    Token command, filename;
+    if (!matchInclude(lexer, token, command, filename)) {
+      watchUndef(token.getTokenKind(), token.getSymbol());
+      lexed_.push(token);
+      continue;
+    }
+    source.guard_.feed(command);
+    source.guard_.feed(filename);
+
+    FileID includefile;
+    lexer.flushDump();
+    if ((!isFailed()) && (resolve(source, filename, includefile))) {
+      include(includefile, filename);
+    }
+    break;
+  }
+
+  segment = {&lexed_, 0, lexed_.size()};
+  return !lexed_.empty();
+}
+
+// tokens of the header up to its next include, read in place from the
+// cache. output and errors of the header are replayed as if it was lexed here
+bool PreProc::pullCached(Source& source, Segment& segment) {
+  const IncludeCache::Entry& entry = *source.entry_;
+  size_t last = entry.tokens_.size();
+  if (source.next_include_ < entry.includes_.size()) {
+    const IncludeCache::Include& included =
+        entry.includes_[source.next_include_];
+    if (included.token_ == source.next_token_) {
+      ++source.next_include_;
+      replay(source, included.error_, included.out_);
+      if (!isFailed()) {
+        include(included.file_, included.filename_);
       }
-      index += 3;
-    } else {
-      processed.push_back(tokens[index]);
-      ++index;
+      return false;
     }
+    last = included.token_;
   }
 
-  for (; index < tokens.size(); ++index) {
-    processed.push_back(tokens[index]);
+  if (source.next_token_ < last) {
+    for (size_t index = source.next_token_; index < last; ++index) {
+      watchUndef(entry.tokens_.getTokenKind(index),
+                 entry.tokens_.getSymbol(index));
+    }
+    segment = {&entry.tokens_, source.next_token_, last};
+    source.next_token_ = last;
+    return true;
   }
 
-  tokens = processed;
+  replay(source, entry.errors_.size(), entry.out_.size());
+  sources_.pop_back();
+  return false;
 }
 
-std::string PreProc::readInludeFile(const std::string& includefile,
-                                    std::vector<char>& buffer) {
-  namespace bf = boost::filesystem;
-  bf::path includepath(filename_);
+void PreProc::replay(Source& source, size_t error_end, size_t out_end) {
+  const IncludeCache::Entry& entry = *source.entry_;
+  auto first_error = entry.errors_.begin() + source.next_error_;
+  size_t error_count =
+      std::min(error_end - source.next_error_, unit_.getErrorRoom());
+  unit_.errors_.insert(unit_.errors_.end(), first_error,
+                       first_error + error_count);
+  unit_.out_.write(entry.out_.data() + source.next_out_,
+                   out_end - source.next_out_);
+  source.next_error_ = error_end;
+  source.next_out_ = out_end;
+}
+
+void PreProc::pushLexed(FileID file) {
+  sources_.push_back({std::unique_ptr<Lexer>(new Lexer(file, unit_)),
+                      nullptr, 0, 0, 0, 0, file, getDir(file),
+                      IncludeGuard()});
+}
+
+// a guarded header lexed to its end is skipped by the next include, as the
+// IncludeCache would have told
+void PreProc::popLexed() {
+  const Source& source = sources_.back();
+  if ((sources_.size() > 1) && (source.guard_.isOnce())) {
+    once_.emplace(source.file_, source.guard_.getMacro());
+  }
+  sources_.pop_back();
+}
+
+bool PreProc::resolve(const Source& source, const Token& filename,
+                      FileID& file) {
+  std::string spelling = filename.getContent().to_string();
+  std::string key = source.dir_ + '\0' + spelling;
+  auto found = resolved_.find(key);
+  if (found == resolved_.end()) {
+    Resolved resolved;
+    try {
+      resolved.file_ =
+          readInludeFile(source.dir_, spelling, unit_, resolved.path_);
+    } catch (std::exception& ec) {
+      unit_.errors_.push_back(
+          CompilerError(DiagID::UNREADABLE_INCLUDE, filename.getRange()));
+      return false;
+    }
+    found = resolved_.emplace(std::move(key), std::move(resolved)).first;
+  }
+  noteInclude(found->second.path_, unit_);
+  file = found->second.file_;
+  return true;
+}
+
+// expand file in place of the include, from the IncludeCache if there is one
+void PreProc::include(FileID file, const Token& filename) {
+  if (included_set_.insert(file).second) {
+    included_.push_back(file);
+  }
+
+  // the guard macro is still defined, nothing to expand
+  if (once_.count(file) != 0) {
+    return;
+  }
+
+  for (const auto& source : sources_) {
+    if (source.file_ == file) {
+      unit_.errors_.push_back(
+          CompilerError(DiagID::RECURSIVE_INCLUDE, filename.getRange()));
+      return;
+    }
+  }
+
+  if (unit_.includes_ == nullptr) {
+    pushLexed(file);
+    return;
+  }
+
+  const IncludeCache::Entry& entry = unit_.includes_->get(file, unit_);
+  if (entry.guard_.isOnce()) {
+    once_.emplace(file, entry.guard_.getMacro());
+  }
+  sources_.push_back(
+      {nullptr, &entry, 0, 0, 0, 0, file, std::string(), IncludeGuard()});
+}
 
-  // Standard library in include
-  // Be compiled code in test
+bool PreProc::isFailed() {
+  for (; checked_errors_ < unit_.errors_.size(); ++checked_errors_) {
+    if (!unit_.errors_[checked_errors_].isWarning()) {
+      failed_ = true;
+    }
+  }
+  return failed_;
+}
 
-  // self include
-  if (includefile[0] == '\"') {
-    includepath = includepath.parent_path().append(includefile.begin() + 1,
-                                                   includefile.end() - 1);
-    std::cout << includepath.string() << std::endl;
+// # undef of a guard macro lets its header be expanded again
+void PreProc::watchUndef(TokenKind kind, SymbolID symbol) {
+  if (kind == TokenKind::SB_POUND) {
+    undef_state_ = 1;
+    return;
   }
-  // standard include
-  else {
-    includepath =
-        bf::path(__FILE__).parent_path().parent_path().append("include").append(
-            includefile.begin() + 1, includefile.end() - 1);
-    std::cout << includepath.string() << std::endl;
+  if (kind != TokenKind::IDENTIFIER) {
+    undef_state_ = 0;
+    return;
+  }
+
+  if ((undef_state_ == 1) && (symbol == SYM_UNDEF)) {
+    undef_state_ = 2;
+    return;
+  }
+  if (undef_state_ == 2) {
+    for (auto once = once_.begin(); once != once_.end();) {
+      once = (once->second == symbol) ? (once_.erase(once))
+                                      : (std::next(once));
+    }
   }
+  undef_state_ = 0;
+}
 
-  std::ifstream ifst(includepath.string());
-  if (!ifst.is_open()) {
-    throw CompilerError("could't open include file " + includefile);
+// # include "file", the three tokens are pulled when they match
+bool PreProc::matchInclude(Lexer& source, const Token& token, Token& command,
+                           Token& filename) {
+  if ((token.getTokenKind() != TokenKind::SB_POUND) ||
+      (!source.peek(0, command)) ||
+      (command.getTokenKind() != TokenKind::IDENTIFIER) ||
+      (command.getSymbol() != SYM_INCLUDE) || (!source.peek(1, filename)) ||
+      (filename.getTokenKind() != TokenKind::INCLUDE)) {
+    return false;
   }
 
-  for (char c; ifst.get(c); buffer.push_back(c)) {
+  source.next(command);
+  source.next(filename);
+  return true;
+}
+
+std::string PreProc::getDir(FileID file) {
+  namespace bf = boost::filesystem;
+  bf::path path(SourceManager::instance().getFileName(file));
+  return path.parent_path().string();
+}
+
+FileID PreProc::readInludeFile(const std::string& dir,
+                               const std::string& includefile,
+                               const CompileUnit& unit,
+                               std::string& includepath) {
+  FileID id;
+  if ((!HeaderSearch::instance().find(unit.search_, dir, includefile,
+                                      includepath)) ||
+      (!SourceManager::instance().loadFile(includepath, id))) {
+    throw CompilerError(DiagID::CANT_OPEN_INCLUDE, includefile);
   }
+  return id;
+}
 
-  return includepath.string();
-}
\ No newline at end of file
+void PreProc::noteInclude(const std::string& includepath,
+                          const CompileUnit& unit) {
+  if ((unit.dump_ == TokenDump::NONE) || (unit.dump_ == TokenDump::TEXT)) {
+    unit.out_ << includepath << '\n';
+  }
+}
@@ -1,26 +1,143 @@
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
+#include "compile_unit.h"
 #include "errors.h"
+#include "include_cache.h"
+#include "include_guard.h"
 #include "lexer.h"
+#include "source_manager.h"
+#include "token_stream.h"
 #include "tokens.h"
 
 #ifndef SRC_PREPROC_H_
 #define SRC_PREPROC_H_
 
+/*
+ PreProc representing the tokens of a file with its includes expanded,
+ pulled from its lexer and from the headers lexed by the IncludeCache
+ sources_ - Source of the file and of every include being expanded in it,
+            the innermost last
+ once_ - Headers expanded that a second include skips, with the macro of
+         their guard
+ resolved_ - File and path an include resolved to, by the directory of the
+             file including it and its spelling, so a repeated include
+             touches no file
+ undef_state_ - Tokens of a # undef seen last, to forget a guard
+ checked_errors_ - Errors of unit_ looked at by isFailed
+ failed_ - True once unit_ has an error, its includes aren't expanded then
+ included_, included_set_ - Files includes resolved to, skipped or not
+ lexed_ - Tokens lexed for the segment handed out last, reused for the next
+ current_ - Part of the segment handed out last not pulled by next yet
+ unit_ - File being compiled, for its arena, errors and output
+ */
 class PreProc {
  public:
-  PreProc(const std::string& filename, bool need_lexer);
+  PreProc(FileID file, CompileUnit& unit);
 
  public:
-  void retokenize(std::vector<Token>& tokens,
-                  std::vector<CompilerError>& errors);
+  /*
+   Segment representing consecutive tokens of the output read in place, from
+   a header in the IncludeCache or from what was just lexed, valid until the
+   next call to next
+   tokens_ - Stream holding them
+   first_, last_ - Range [first_, last_) of them in tokens_
+   */
+  struct Segment {
+    const TokenStream* tokens_;
+    size_t first_;
+    size_t last_;
+  };
+
+ public:
+  // next run of tokens after preprocessing, false at the end of the file
+  bool next(Segment& segment);
+  // next token after preprocessing, false at the end of the file
+  bool next(Token& token);
+
+  // every file an include of the file resolved to, in the order first seen
+  const std::vector<FileID>& getIncludedFiles() const;
+
+  // lex a header into entry, its includes recorded where they are
+  static void lexHeader(FileID file, const CompileUnit& unit,
+                        IncludeCache::Entry& entry);
 
  private:
-  std::string readInludeFile(const std::string& includefile,
-                             std::vector<char>& buffer);
+  /*
+   Source representing one file being expanded, lexed as it goes or
+   replayed from the IncludeCache
+   lexer_ - Lexer of the file, nullptr for a header from the cache
+   entry_ - Header from the cache
+   next_token_, next_include_, next_error_, next_out_ - Next token,
+                include, error and output of entry_ to hand out
+   file_ - File being expanded
+   dir_ - Directory of file_, its "file" includes are looked for there first
+   guard_ - Include guard of the file, fed as lexer_ lexes it
+   */
+  struct Source {
+    std::unique_ptr<Lexer> lexer_;
+    const IncludeCache::Entry* entry_;
+    size_t next_token_;
+    size_t next_include_;
+    size_t next_error_;
+    size_t next_out_;
+    FileID file_;
+    std::string dir_;
+    IncludeGuard guard_;
+  };
+
+  /*
+   Resolved representing what an include resolved to
+   file_ - File loaded
+   path_ - Path found for it
+   */
+  struct Resolved {
+    FileID file_;
+    std::string path_;
+  };
+
+  bool pull(Segment& segment);
+  bool pullLexed(Source& source, Segment& segment);
+  bool pullCached(Source& source, Segment& segment);
+  void replay(Source& source, size_t error_end, size_t out_end);
+  void pushLexed(FileID file);
+  void popLexed();
+  // file an include of source resolves to, false if it can't be read
+  bool resolve(const Source& source, const Token& filename, FileID& file);
+  void include(FileID file, const Token& filename);
+  // true once the file has an error, it won't compile whatever its
+  // includes hold
+  bool isFailed();
+  void watchUndef(TokenKind kind, SymbolID symbol);
+
+  static bool matchInclude(Lexer& source, const Token& token, Token& command,
+                           Token& filename);
+  static std::string getDir(FileID file);
+  static FileID readInludeFile(const std::string& dir,
+                               const std::string& includefile,
+                               const CompileUnit& unit,
+                               std::string& includepath);
+  // the path found is noted in the output of unit unless its tokens are
+  // dumped for a tool to read
+  static void noteInclude(const std::string& includepath,
+                          const CompileUnit& unit);
 
  private:
-  std::string filename_;
-  bool need_lexer_;
+  std::vector<Source> sources_;
+  std::unordered_map<FileID, SymbolID> once_;
+  std::unordered_map<std::string, Resolved> resolved_;
+  int undef_state_;
+  size_t checked_errors_;
+  bool failed_;
+  std::vector<FileID> included_;
+  std::unordered_set<FileID> included_set_;
+  TokenStream lexed_;
+  Segment current_;
+  CompileUnit& unit_;
 };
 
 #endif  // SRC_PREPROC_H_
@@ -0,0 +1,218 @@
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AYCC_SCAN_X86 1
+#endif
+
+#include <string>
+
+#include "char_class.h"
+
+static const char* skipBlanksScalar(const char* begin, const char* end) {
+  while ((begin < end) && (isBlankChar(*begin))) {
+    ++begin;
+  }
+  return begin;
+}
+
+static const char* findCommentEndScalar(const char* begin, const char* end) {
+  for (; begin < end; ++begin) {
+    if ((*begin == '\n') ||
+        ((*begin == '*') && (begin + 1 < end) && (begin[1] == '/'))) {
+      return begin;
+    }
+  }
+  return end;
+}
+
+static const char* findStringSpecialScalar(const char* begin, const char* end,
+                                           char quote) {
+  for (; begin < end; ++begin) {
+    if ((*begin == quote) || (*begin == '\\') || (*begin == '\n')) {
+      return begin;
+    }
+  }
+  return end;
+}
+
+#ifdef AYCC_SCAN_X86
+__attribute__((target("sse2"))) static const char* skipBlanksSse2(
+    const char* begin, const char* end) {
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  for (; begin + 16 <= end; begin += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(chunk, space),
+                                 _mm_cmpeq_epi8(chunk, tab));
+    unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(blank)) & 0xFFFF;
+    if (mask != 0) {
+      return begin + __builtin_ctz(mask);
+    }
+  }
+  return skipBlanksScalar(begin, end);
+}
+
+__attribute__((target("sse2"))) static const char* findCommentEndSse2(
+    const char* begin, const char* end) {
+  const __m128i star = _mm_set1_epi8('*');
+  const __m128i slash = _mm_set1_epi8('/');
+  const __m128i newline = _mm_set1_epi8('\n');
+  // the second load looks one byte ahead for the '/' of "*/"
+  for (; begin + 17 <= end; begin += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    __m128i next =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin + 1));
+    __m128i hit = _mm_or_si128(
+        _mm_and_si128(_mm_cmpeq_epi8(chunk, star), _mm_cmpeq_epi8(next, slash)),
+        _mm_cmpeq_epi8(chunk, newline));
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+    if (mask != 0) {
+      return begin + __builtin_ctz(mask);
+    }
+  }
+  return findCommentEndScalar(begin, end);
+}
+
+__attribute__((target("sse2"))) static const char* findStringSpecialSse2(
+    const char* begin, const char* end, char quote) {
+  const __m128i quotes = _mm_set1_epi8(quote);
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i newline = _mm_set1_epi8('\n');
+  for (; begin + 16 <= end; begin += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    __m128i hit = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, quotes),
+                     _mm_cmpeq_epi8(chunk, backslash)),
+        _mm_cmpeq_epi8(chunk, newline));
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+    if (mask != 0) {
+      return begin + __builtin_ctz(mask);
+    }
+  }
+  return findStringSpecialScalar(begin, end, quote);
+}
+
+__attribute__((target("avx2"))) static const char* skipBlanksAvx2(
+    const char* begin, const char* end) {
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  for (; begin + 32 <= end; begin += 32) {
+    __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+    __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, space),
+                                    _mm256_cmpeq_epi8(chunk, tab));
+    unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(blank));
+    if (mask != 0) {
+      return begin + __builtin_ctz(mask);
+    }
+  }
+  return skipBlanksSse2(begin, end);
+}
+
+__attribute__((target("avx2"))) static const char* findCommentEndAvx2(
+    const char* begin, const char* end) {
+  const __m256i star = _mm256_set1_epi8('*');
+  const __m256i slash = _mm256_set1_epi8('/');
+  const __m256i newline = _mm256_set1_epi8('\n');
+  for (; begin + 33 <= end; begin += 32) {
+    __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+    __m256i next =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin + 1));
+    __m256i hit =
+        _mm256_or_si256(_mm256_and_si256(_mm256_cmpeq_epi8(chunk, star),
+                                         _mm256_cmpeq_epi8(next, slash)),
+                        _mm256_cmpeq_epi8(chunk, newline));
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+    if (mask != 0) {
+      return begin + __builtin_ctz(mask);
+    }
+  }
+  return findCommentEndSse2(begin, end);
+}
+
+__attribute__((target("avx2"))) static const char* findStringSpecialAvx2(
+    const char* begin, const char* end, char quote) {
+  const __m256i quotes = _mm256_set1_epi8(quote);
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  const __m256i newline = _mm256_set1_epi8('\n');
+  for (; begin + 32 <= end; begin += 32) {
+    __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+    __m256i hit = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quotes),
+                        _mm256_cmpeq_epi8(chunk, backslash)),
+        _mm256_cmpeq_epi8(chunk, newline));
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+    if (mask != 0) {
+      return begin + __builtin_ctz(mask);
+    }
+  }
+  return findStringSpecialSse2(begin, end, quote);
+}
+#endif  // AYCC_SCAN_X86
+
+/*
+ ScanKernels representing one implementation of every scanner
+ name_ - Name reported by scanKernelName
+ */
+struct ScanKernels {
+  const char* name_;
+  const char* (*skip_blanks_)(const char*, const char*);
+  const char* (*find_comment_end_)(const char*, const char*);
+  const char* (*find_string_special_)(const char*, const char*, char);
+};
+
+// kernels named name, or the best ones the CPU supports for nullptr, false
+// if there are none
+static bool findScanKernels(const char* name, ScanKernels& kernels) {
+  std::string wanted = (name != nullptr) ? (name) : ("");
+#ifdef AYCC_SCAN_X86
+  __builtin_cpu_init();
+  if ((__builtin_cpu_supports("avx2")) &&
+      ((wanted.empty()) || (wanted == "avx2"))) {
+    kernels = {"avx2", skipBlanksAvx2, findCommentEndAvx2,
+               findStringSpecialAvx2};
+    return true;
+  }
+  if ((__builtin_cpu_supports("sse2")) &&
+      ((wanted.empty()) || (wanted == "sse2"))) {
+    kernels = {"sse2", skipBlanksSse2, findCommentEndSse2,
+               findStringSpecialSse2};
+    return true;
+  }
+#endif
+  if ((wanted.empty()) || (wanted == "scalar")) {
+    kernels = {"scalar", skipBlanksScalar, findCommentEndScalar,
+               findStringSpecialScalar};
+    return true;
+  }
+  return false;
+}
+
+static ScanKernels selectScanKernels() {
+  ScanKernels kernels;
+  findScanKernels(nullptr, kernels);
+  return kernels;
+}
+
+static ScanKernels scan_kernels = selectScanKernels();
+
+const char* skipBlanks(const char* begin, const char* end) {
+  return scan_kernels.skip_blanks_(begin, end);
+}
+
+const char* findCommentEnd(const char* begin, const char* end) {
+  return scan_kernels.find_comment_end_(begin, end);
+}
+
+const char* findStringSpecial(const char* begin, const char* end, char quote) {
+  return scan_kernels.find_string_special_(begin, end, quote);
+}
+
+const char* scanKernelName() { return scan_kernels.name_; }
+
+bool useScanKernels(const char* name) {
+  return findScanKernels(name, scan_kernels);
+}
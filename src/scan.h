@@ -0,0 +1,25 @@
+#ifndef SRC_SCAN_H_
+#define SRC_SCAN_H_
+
+/*
+ Byte scanners for the long runs the lexer has to step over. Each one has
+ an AVX2, an SSE2 and a scalar kernel, the best one the CPU supports is
+ chosen once at startup. All of them return end when nothing is found.
+ */
+
+// first byte in [begin, end) that isn't ' ' or '\t'
+const char* skipBlanks(const char* begin, const char* end);
+
+// first "*/" or '\n' in [begin, end), a "*/" is reported at its '*'
+const char* findCommentEnd(const char* begin, const char* end);
+
+// first quote, '\\' or '\n' in [begin, end)
+const char* findStringSpecial(const char* begin, const char* end, char quote);
+
+// name of the kernels in use, "avx2", "sse2" or "scalar"
+const char* scanKernelName();
+
+// use the kernels named as scanKernelName names them from now on, false if
+// the CPU lacks them. for benchmarks, nothing may be lexing meanwhile
+bool useScanKernels(const char* name);
+#endif  // SRC_SCAN_H_
@@ -0,0 +1,217 @@
+#include "source_buffer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+// smallest heap an edited buffer grows to, so small edits don't realloc
+static constexpr size_t min_edit_capacity = 4 * 1024;
+
+SourceBuffer::SourceBuffer()
+    : data_(nullptr), size_(0), capacity_(0), gap_(0), mapped_(false) {}
+
+SourceBuffer::~SourceBuffer() { release(); }
+
+SourceBuffer::SourceBuffer(SourceBuffer&& other)
+    : data_(other.data_),
+      size_(other.size_),
+      capacity_(other.capacity_),
+      gap_(other.gap_),
+      mapped_(other.mapped_) {
+  other.data_ = nullptr;
+  other.size_ = 0;
+  other.capacity_ = 0;
+  other.gap_ = 0;
+  other.mapped_ = false;
+}
+
+SourceBuffer& SourceBuffer::operator=(SourceBuffer&& other) {
+  if (this != &other) {
+    release();
+    data_ = other.data_;
+    size_ = other.size_;
+    capacity_ = other.capacity_;
+    gap_ = other.gap_;
+    mapped_ = other.mapped_;
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.capacity_ = 0;
+    other.gap_ = 0;
+    other.mapped_ = false;
+  }
+  return *this;
+}
+
+bool SourceBuffer::open(const std::string& file) {
+  release();
+
+  int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if ((fstat(fd, &st) != 0) || (S_ISDIR(st.st_mode))) {
+    ::close(fd);
+    return false;
+  }
+
+  // regular files are mapped, empty ones need no storage at all
+  if (S_ISREG(st.st_mode)) {
+    if (st.st_size == 0) {
+      ::close(fd);
+      return true;
+    }
+
+    void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                      MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED) {
+      madvise(addr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+      data_ = static_cast<char*>(addr);
+      size_ = static_cast<size_t>(st.st_size);
+      capacity_ = size_;
+      gap_ = size_;
+      mapped_ = true;
+      ::close(fd);
+      return true;
+    }
+  }
+
+  bool ok = readAll(fd);
+  ::close(fd);
+  return ok;
+}
+
+bool SourceBuffer::assign(const char* data, size_t size) {
+  release();
+  if (size == 0) {
+    return true;
+  }
+  data_ = static_cast<char*>(malloc(size));
+  if (data_ == nullptr) {
+    return false;
+  }
+  memcpy(data_, data, size);
+  size_ = size;
+  capacity_ = size;
+  gap_ = size;
+  return true;
+}
+
+bool SourceBuffer::replace(size_t offset, size_t length, const char* data,
+                           size_t size) {
+  // a mapped file is read-only, it is copied the first time it is edited
+  if (mapped_) {
+    SourceBuffer copy;
+    if (!copy.assign(data_, size_)) {
+      return false;
+    }
+    *this = std::move(copy);
+  }
+
+  size_t new_size = size_ - length + size;
+  if (new_size > capacity_) {
+    // grown to twice the size with the gap at the end, then moved to offset
+    moveGap(size_);
+    size_t capacity = std::max(std::max(new_size, capacity_ * 2),
+                               min_edit_capacity);
+    char* grown = static_cast<char*>(realloc(data_, capacity));
+    if (grown == nullptr) {
+      return false;
+    }
+    data_ = grown;
+    capacity_ = capacity;
+  }
+
+  // the bytes replaced join the gap, the new ones are put at its start
+  moveGap(offset);
+  size_ -= length;
+  if (size > 0) {
+    memcpy(data_ + gap_, data, size);
+  }
+  gap_ += size;
+  size_ += size;
+  return true;
+}
+
+const char* SourceBuffer::begin() const { return prefix(size_); }
+
+const char* SourceBuffer::end() const { return prefix(size_) + size_; }
+
+const char* SourceBuffer::prefix(size_t size) const {
+  if (gap_ < size) {
+    moveGap(size);
+  }
+  return data_;
+}
+
+char SourceBuffer::at(size_t offset) const {
+  return (offset < gap_) ? (data_[offset])
+                         : (data_[offset + capacity_ - size_]);
+}
+
+size_t SourceBuffer::size() const { return size_; }
+
+bool SourceBuffer::empty() const { return size_ == 0; }
+
+bool SourceBuffer::readAll(int fd) {
+  size_t capacity = 0;
+  for (;;) {
+    if (size_ == capacity) {
+      capacity = (capacity == 0) ? (64 * 1024) : (capacity * 2);
+      char* grown = static_cast<char*>(realloc(data_, capacity));
+      if (grown == nullptr) {
+        release();
+        return false;
+      }
+      data_ = grown;
+      capacity_ = capacity;
+    }
+
+    ssize_t n = ::read(fd, data_ + size_, capacity - size_);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      release();
+      return false;
+    }
+    if (n == 0) {
+      gap_ = size_;
+      return true;
+    }
+    size_ += static_cast<size_t>(n);
+  }
+}
+
+// only the bytes between the old and the new place of the gap move
+void SourceBuffer::moveGap(size_t offset) const {
+  size_t gap_size = capacity_ - size_;
+  if ((gap_size > 0) && (offset < gap_)) {
+    memmove(data_ + offset + gap_size, data_ + offset, gap_ - offset);
+  } else if ((gap_size > 0) && (offset > gap_)) {
+    memmove(data_ + gap_, data_ + gap_ + gap_size, offset - gap_);
+  }
+  gap_ = offset;
+}
+
+void SourceBuffer::release() {
+  if (data_ != nullptr) {
+    if (mapped_) {
+      munmap(data_, size_);
+    } else {
+      free(data_);
+    }
+  }
+  data_ = nullptr;
+  size_ = 0;
+  capacity_ = 0;
+  gap_ = 0;
+  mapped_ = false;
+}
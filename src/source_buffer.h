@@ -0,0 +1,60 @@
+#include <cstddef>
+#include <string>
+
+#ifndef SRC_SOURCE_BUFFER_H_
+#define SRC_SOURCE_BUFFER_H_
+
+/*
+ SourceBuffer representing the bytes of one source file, owned exactly once.
+ An edited buffer is a gap buffer: the gap stays where the last edit was, so
+ the next edit nearby moves only the bytes in between, and is closed when
+ the bytes after it are read
+ data_ - First byte of the file, either mmap'd or read into the heap
+ size_ - Number of bytes in the file
+ capacity_ - Bytes at data_, the gap is capacity_ - size_ of them
+ gap_ - Offset the gap is at, the bytes after it follow the gap
+ mapped_ - True if data_ must be released with munmap, false for free
+ */
+class SourceBuffer {
+ public:
+  SourceBuffer();
+  ~SourceBuffer();
+  SourceBuffer(SourceBuffer&& other);
+  SourceBuffer& operator=(SourceBuffer&& other);
+
+  SourceBuffer(const SourceBuffer&) = delete;
+  SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+ public:
+  // map a regular file, or read() it when it can't be mapped (pipes, ttys)
+  bool open(const std::string& file);
+  // own a copy of size bytes at data, for buffers that aren't files
+  bool assign(const char* data, size_t size);
+  // replace length bytes at offset by size bytes at data, in memory. the
+  // gap is left after them
+  bool replace(size_t offset, size_t length, const char* data, size_t size);
+
+  // the whole buffer in one piece, the gap moved out of the way
+  const char* begin() const;
+  const char* end() const;
+  // begin() with only the first size bytes in one piece, the gap moved past
+  // them if it is before
+  const char* prefix(size_t size) const;
+  // byte at offset wherever the gap is
+  char at(size_t offset) const;
+  size_t size() const;
+  bool empty() const;
+
+ private:
+  bool readAll(int fd);
+  void moveGap(size_t offset) const;
+  void release();
+
+ private:
+  char* data_;
+  size_t size_;
+  size_t capacity_;
+  mutable size_t gap_;
+  bool mapped_;
+};
+#endif  // SRC_SOURCE_BUFFER_H_
@@ -0,0 +1,309 @@
+#include "source_manager.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "errors.h"
+
+SourceManager::SourceManager()
+    : chunks_(),
+      count_(0),
+      ids_(),
+      mutex_(),
+      generation_(0),
+      stale_count_(0) {}
+
+SourceManager& SourceManager::instance() {
+  static SourceManager manager;
+  return manager;
+}
+
+bool SourceManager::loadFile(const std::string& file, FileID& id) {
+  struct stat st;
+  if (stat(file.c_str(), &st) != 0) {
+    return false;
+  }
+
+  // an unchanged regular file is shared by every include of it
+  auto loaded = [this, &file, &st](FileID& id) {
+    auto found = ids_.find(file);
+    if ((found == ids_.end()) || (!S_ISREG(st.st_mode))) {
+      return false;
+    }
+    const FileEntry& entry = entryAt(found->second);
+    id = found->second;
+    return (entry.buffer_.size() == static_cast<size_t>(st.st_size)) &&
+           (entry.mtime_.tv_sec == st.st_mtim.tv_sec) &&
+           (entry.mtime_.tv_nsec == st.st_mtim.tv_nsec);
+  };
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (loaded(id)) {
+      return true;
+    }
+  }
+
+  // read without the lock, other threads go on reading and loading files
+  std::unique_ptr<FileEntry> entry(new FileEntry());
+  if (!entry->buffer_.open(file)) {
+    return false;
+  }
+  // offsets in a file are 32-bit
+  if (entry->buffer_.size() > std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+  entry->name_ = file;
+  entry->mtime_ = st.st_mtim;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  // another thread may have loaded the same revision meanwhile
+  if (loaded(id)) {
+    return true;
+  }
+  auto found = ids_.find(file);
+  if (found != ids_.end()) {
+    markStale(found->second);
+  }
+  id = addEntry(std::move(entry));
+  ids_[file] = id;
+  return true;
+}
+
+bool SourceManager::addBuffer(const std::string& name,
+                              const std::string& text, FileID& id) {
+  std::unique_ptr<FileEntry> entry(new FileEntry());
+  if ((text.size() > std::numeric_limits<uint32_t>::max()) ||
+      (!entry->buffer_.assign(text.data(), text.size()))) {
+    return false;
+  }
+  entry->name_ = name;
+  entry->mtime_ = {0, 0};
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  id = addEntry(std::move(entry));
+  return true;
+}
+
+bool SourceManager::editBuffer(FileID id, uint32_t offset, uint32_t length,
+                               const std::string& text) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (id >= count_) {
+    return false;
+  }
+  FileEntry& entry = entryAt(id);
+  size_t size = entry.buffer_.size();
+  if ((offset > size) || (length > size - offset) ||
+      (size - length + text.size() > std::numeric_limits<uint32_t>::max()) ||
+      (!entry.buffer_.replace(offset, length, text.data(), text.size()))) {
+    return false;
+  }
+
+  // the gap goes after the lines starting up to offset, those starting in
+  // the bytes replaced go, those of text come. the ones after the gap count
+  // from the end and stay as they are
+  GapVector<uint32_t>& starts = entry.line_starts_;
+  if (starts.size() == 0) {
+    return true;
+  }
+  while ((starts.frontSize() > 0) && (starts.lastFront() > offset)) {
+    starts.moveToBack(static_cast<uint32_t>(size - starts.lastFront()));
+  }
+  while ((starts.backSize() > 0) && (size - starts.firstBack() <= offset)) {
+    starts.moveToFront(static_cast<uint32_t>(size - starts.firstBack()));
+  }
+  while ((starts.backSize() > 0) &&
+         (size - starts.firstBack() <= offset + length)) {
+    starts.dropBack(1);
+  }
+  for (size_t index = 0; index < text.size(); ++index) {
+    if (text[index] == '\n') {
+      starts.pushFront(offset + static_cast<uint32_t>(index) + 1);
+    }
+  }
+  return true;
+}
+
+const std::string& SourceManager::getFileName(FileID id) const {
+  return getEntry(id).name_;
+}
+
+const SourceBuffer& SourceManager::getBuffer(FileID id) const {
+  return getEntry(id).buffer_;
+}
+
+struct timespec SourceManager::getModifiedTime(FileID id) const {
+  return getEntry(id).mtime_;
+}
+
+size_t SourceManager::getLine(FileID id, uint32_t offset) const {
+  return findLineIndex(getEntry(id), offset) + 1;
+}
+
+size_t SourceManager::getColumn(FileID id, uint32_t offset) const {
+  const FileEntry& entry = getEntry(id);
+  return offset - getLineStart(entry, findLineIndex(entry, offset)) + 1;
+}
+
+std::string SourceManager::getLineText(FileID id, uint32_t offset) const {
+  const FileEntry& entry = getEntry(id);
+  const char* line_begin =
+      entry.buffer_.begin() + getLineStart(entry, findLineIndex(entry, offset));
+  const char* line_end = std::find(line_begin, entry.buffer_.end(), '\n');
+  return std::string(line_begin, line_end);
+}
+
+size_t SourceManager::refresh() {
+  std::vector<std::pair<std::string, FileID>> loaded;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    loaded.assign(ids_.begin(), ids_.end());
+  }
+
+  // stat without the lock, the files are compared once it is taken again
+  std::vector<std::pair<FileID, struct stat>> found;
+  std::vector<FileID> gone;
+  for (const auto& file : loaded) {
+    struct stat st;
+    if (stat(file.first.c_str(), &st) != 0) {
+      gone.push_back(file.second);
+    } else {
+      found.push_back({file.second, st});
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t count = 0;
+  auto drop = [this, &count](FileID id) {
+    const FileEntry& entry = entryAt(id);
+    auto current = ids_.find(entry.name_);
+    if ((current != ids_.end()) && (current->second == id)) {
+      ids_.erase(current);
+      markStale(id);
+      ++count;
+    }
+  };
+  for (FileID id : gone) {
+    drop(id);
+  }
+  for (const auto& file : found) {
+    const FileEntry& entry = entryAt(file.first);
+    const struct stat& st = file.second;
+    if ((!S_ISREG(st.st_mode)) ||
+        (entry.buffer_.size() != static_cast<size_t>(st.st_size)) ||
+        (entry.mtime_.tv_sec != st.st_mtim.tv_sec) ||
+        (entry.mtime_.tv_nsec != st.st_mtim.tv_nsec)) {
+      drop(file.first);
+    }
+  }
+  return count;
+}
+
+bool SourceManager::isCurrent(FileID id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return (id < count_) && (!entryAt(id).stale_);
+}
+
+uint64_t SourceManager::getGeneration() const { return generation_; }
+
+size_t SourceManager::getStaleCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stale_count_;
+}
+
+void SourceManager::releaseStale() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (FileID id = 0; id < count_; ++id) {
+    FileEntry& entry = entryAt(id);
+    if ((entry.stale_) && (!entry.released_)) {
+      entry.buffer_ = SourceBuffer();
+      entry.line_starts_ = GapVector<uint32_t>();
+      entry.released_ = true;
+    }
+  }
+  stale_count_ = 0;
+}
+
+void SourceManager::markStale(FileID id) {
+  FileEntry& entry = entryAt(id);
+  if (!entry.stale_) {
+    entry.stale_ = true;
+    ++stale_count_;
+    ++generation_;
+  }
+}
+
+const SourceManager::FileEntry& SourceManager::getEntry(FileID id) const {
+  // count_ is stored after the entry, whoever sees it sees the entry
+  if (id >= count_.load(std::memory_order_acquire)) {
+    throw CompilerError(DiagID::INVALID_FILE_ID, std::to_string(id));
+  }
+  return entryAt(id);
+}
+
+SourceManager::FileEntry& SourceManager::entryAt(FileID id) const {
+  // chunk k starts at (2^k - 1) * first_chunk_size
+  uint64_t slot = static_cast<uint64_t>(id) + first_chunk_size;
+  size_t chunk = (63 - __builtin_clzll(slot)) - first_chunk_bits;
+  return *chunks_[chunk][slot - (first_chunk_size << chunk)];
+}
+
+FileID SourceManager::addEntry(std::unique_ptr<FileEntry> entry) {
+  size_t count = count_.load(std::memory_order_relaxed);
+  if (count > std::numeric_limits<FileID>::max()) {
+    throw CompilerError(DiagID::INVALID_FILE_ID, std::to_string(count));
+  }
+  uint64_t slot = static_cast<uint64_t>(count) + first_chunk_size;
+  size_t chunk = (63 - __builtin_clzll(slot)) - first_chunk_bits;
+  if (!chunks_[chunk]) {
+    chunks_[chunk].reset(
+        new std::unique_ptr<FileEntry>[first_chunk_size << chunk]);
+  }
+  chunks_[chunk][slot - (first_chunk_size << chunk)] = std::move(entry);
+  count_.store(count + 1, std::memory_order_release);
+  return static_cast<FileID>(count);
+}
+
+size_t SourceManager::findLineIndex(const FileEntry& entry,
+                                    uint32_t offset) const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (entry.line_starts_.size() == 0) {
+    const char* begin = entry.buffer_.begin();
+    const char* end = entry.buffer_.end();
+    entry.line_starts_.pushFront(0);
+    for (const char* p = begin; p < end; ++p) {
+      p = static_cast<const char*>(memchr(p, '\n', end - p));
+      if (p == nullptr) {
+        break;
+      }
+      entry.line_starts_.pushFront(static_cast<uint32_t>(p + 1 - begin));
+    }
+  }
+  // built once, read without the lock from here on
+  lock.unlock();
+
+  // last line starting at or before offset
+  size_t low = 0;
+  size_t high = entry.line_starts_.size();
+  while (high - low > 1) {
+    size_t middle = low + (high - low) / 2;
+    if (getLineStart(entry, middle) <= offset) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+uint32_t SourceManager::getLineStart(const FileEntry& entry, size_t index) {
+  uint32_t start = entry.line_starts_[index];
+  if (index >= entry.line_starts_.frontSize()) {
+    start = static_cast<uint32_t>(entry.buffer_.size() - start);
+  }
+  return start;
+}
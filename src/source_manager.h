@@ -0,0 +1,116 @@
+#include <sys/types.h>
+#include <time.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "gap_vector.h"
+#include "source_buffer.h"
+
+#ifndef SRC_SOURCE_MANAGER_H_
+#define SRC_SOURCE_MANAGER_H_
+
+using FileID = uint32_t;
+
+/*
+ SourceManager representing every source file loaded by the compiler,
+ shared by the threads compiling files in parallel. A file changed on disk
+ is loaded again under a new FileID and the old revision goes stale, its
+ bytes kept until nobody can hold tokens of it. Files are read without the
+ lock and entries are found without it, so tokens reach their bytes freely
+ chunks_ - Entries by FileID, chunk k holding first_chunk_size << k of them.
+           Chunks and entries are never moved, so a FileID below count_
+           stays valid without the lock
+ count_ - Entries published in chunks_
+ ids_ - Path of a loaded file to its FileID, so a file is mapped once
+ mutex_ - Guards adding to chunks_, ids_, stale_count_, stale_ of entries
+          and building line_starts_ of an entry
+ generation_ - Bumped whenever a revision goes stale
+ stale_count_ - Stale revisions still holding their bytes
+ */
+class SourceManager {
+ public:
+  static SourceManager& instance();
+
+ public:
+  bool loadFile(const std::string& file, FileID& id);
+  // a buffer held in memory only, for editors. only the thread editing it
+  // may read it
+  bool addBuffer(const std::string& name, const std::string& text,
+                 FileID& id);
+  bool editBuffer(FileID id, uint32_t offset, uint32_t length,
+                  const std::string& text);
+
+  const std::string& getFileName(FileID id) const;
+  const SourceBuffer& getBuffer(FileID id) const;
+  // modification time of the file when its buffer was loaded
+  struct timespec getModifiedTime(FileID id) const;
+
+  // 1-based line and column, computed from the line-start table on demand
+  size_t getLine(FileID id, uint32_t offset) const;
+  size_t getColumn(FileID id, uint32_t offset) const;
+  std::string getLineText(FileID id, uint32_t offset) const;
+
+  // files changed or gone on disk since they were loaded go stale, the
+  // number that did is returned
+  size_t refresh();
+  // false once a newer revision of the file is loaded or it is refreshed
+  bool isCurrent(FileID id) const;
+  uint64_t getGeneration() const;
+  size_t getStaleCount() const;
+  // frees the bytes of stale revisions, their FileIDs stay valid but empty.
+  // no thread may hold tokens of them
+  void releaseStale();
+
+ private:
+  SourceManager();
+
+  /*
+   FileEntry representing one loaded file
+   name_ - Path the file was loaded from
+   buffer_ - Bytes of the file
+   mtime_ - Modification time when loaded, to the nanosecond so a compile
+            server notices a file changed within the same second
+   line_starts_ - Offset of the first byte of every line, built lazily.
+                  Edits patch it at its gap, those after the gap count
+                  from the end of the buffer
+   stale_ - True once a newer revision is loaded or the file changed
+   released_ - True once buffer_ of a stale revision is freed
+   */
+  struct FileEntry {
+    std::string name_;
+    SourceBuffer buffer_;
+    struct timespec mtime_;
+    mutable GapVector<uint32_t> line_starts_;
+    bool stale_ = false;
+    bool released_ = false;
+  };
+
+  const FileEntry& getEntry(FileID id) const;
+  // id is below count_, no lock needed
+  FileEntry& entryAt(FileID id) const;
+  // mutex_ is held
+  FileID addEntry(std::unique_ptr<FileEntry> entry);
+  void markStale(FileID id);
+  size_t findLineIndex(const FileEntry& entry, uint32_t offset) const;
+  static uint32_t getLineStart(const FileEntry& entry, size_t index);
+
+ private:
+  // enough chunks for every FileID
+  static constexpr size_t first_chunk_bits = 10;
+  static constexpr size_t first_chunk_size = size_t(1) << first_chunk_bits;
+  static constexpr size_t chunk_count = 33 - first_chunk_bits;
+
+  std::unique_ptr<std::unique_ptr<FileEntry>[]> chunks_[chunk_count];
+  std::atomic<size_t> count_;
+  std::unordered_map<std::string, FileID> ids_;
+  mutable std::mutex mutex_;
+  std::atomic<uint64_t> generation_;
+  size_t stale_count_;
+};
+#endif  // SRC_SOURCE_MANAGER_H_
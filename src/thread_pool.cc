@@ -0,0 +1,98 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(size_t threads)
+    : queues_(),
+      workers_(),
+      mutex_(),
+      wake_(),
+      idle_(),
+      queued_(0),
+      pending_(0),
+      next_queue_(0),
+      stopping_(false) {
+  threads = (threads > 0) ? (threads) : (1);
+  for (size_t worker = 0; worker < threads; ++worker) {
+    queues_.emplace_back(new WorkQueue());
+  }
+  for (size_t worker = 0; worker < threads; ++worker) {
+    workers_.emplace_back(&ThreadPool::work, this, worker);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+size_t ThreadPool::size() const { return workers_.size(); }
+
+void ThreadPool::submit(Task task) {
+  {
+    // mutex_ is taken before a queue lock, never after
+    std::lock_guard<std::mutex> lock(mutex_);
+    WorkQueue& queue = *queues_[next_queue_];
+    next_queue_ = (next_queue_ + 1) % queues_.size();
+    {
+      std::lock_guard<std::mutex> queue_lock(queue.mutex_);
+      queue.tasks_.push_back(std::move(task));
+    }
+    ++queued_;
+    ++pending_;
+  }
+  wake_.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this] { return pending_ == 0; });
+}
+
+void ThreadPool::work(size_t worker) {
+  while (true) {
+    Task task;
+    if (popTask(worker, task)) {
+      task(worker);
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--pending_ == 0) {
+        idle_.notify_all();
+      }
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    wake_.wait(lock, [this] { return (stopping_) || (queued_ > 0); });
+    if ((stopping_) && (queued_ == 0)) {
+      return;
+    }
+  }
+}
+
+bool ThreadPool::popTask(size_t worker, Task& task) {
+  for (size_t step = 0; step < queues_.size(); ++step) {
+    WorkQueue& queue = *queues_[(worker + step) % queues_.size()];
+    std::unique_lock<std::mutex> queue_lock(queue.mutex_);
+    if (queue.tasks_.empty()) {
+      continue;
+    }
+    // own work in order, stolen work from the cheap end
+    if (step == 0) {
+      task = std::move(queue.tasks_.front());
+      queue.tasks_.pop_front();
+    } else {
+      task = std::move(queue.tasks_.back());
+      queue.tasks_.pop_back();
+    }
+    queue_lock.unlock();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    --queued_;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,70 @@
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef SRC_THREAD_POOL_H_
+#define SRC_THREAD_POOL_H_
+
+/*
+ ThreadPool representing worker threads running queued tasks, every worker
+ has its own queue and steals from the others once it runs dry
+ queues_ - Queue of every worker, its owner takes from the front and
+           thieves from the back
+ workers_ - Threads of the pool
+ mutex_ - Guards queued_, pending_ and stopping_
+ wake_ - Signalled when a task is queued or the pool stops
+ idle_ - Signalled when the last pending task is done
+ queued_ - Tasks waiting in a queue
+ pending_ - Tasks queued or running
+ next_queue_ - Queue the next submitted task goes to
+ stopping_ - True once the pool is being destroyed
+ */
+class ThreadPool {
+ public:
+  // the argument of a task is the index of the worker running it
+  using Task = std::function<void(size_t)>;
+
+  explicit ThreadPool(size_t threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+ public:
+  size_t size() const;
+  // tasks submitted first are run first by their worker, an exception
+  // leaving a task ends the program
+  void submit(Task task);
+  // block until every submitted task has run
+  void wait();
+
+ private:
+  /*
+   WorkQueue representing the tasks given to one worker
+   mutex_ - Guards tasks_
+   tasks_ - Tasks not started yet
+   */
+  struct WorkQueue {
+    std::mutex mutex_;
+    std::deque<Task> tasks_;
+  };
+
+  void work(size_t worker);
+  bool popTask(size_t worker, Task& task);
+
+ private:
+  std::vector<std::unique_ptr<WorkQueue>> queues_;
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  size_t queued_;
+  size_t pending_;
+  size_t next_queue_;
+  bool stopping_;
+};
+#endif  // SRC_THREAD_POOL_H_
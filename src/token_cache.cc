@@ -0,0 +1,342 @@
+#include "token_cache.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include "header_search.h"
+#include "include_guard.h"
+#include "interner.h"
+#include "tokens.h"
+
+// bumped whenever the layout below changes
+static constexpr uint32_t format_version = 1;
+static const char magic[8] = {'A', 'Y', 'C', 'C', 'T', 'O', 'K', '\0'};
+
+/*
+ CacheHeader representing the start of a cache file, followed by its body
+ magic_ - Identifies a cache file
+ version_ - format_version of the writer
+ kind_count_ - Number of token kinds of the writer
+ body_size_ - Bytes of the body
+ body_hash_ - Hash of the body
+ */
+struct CacheHeader {
+  char magic_[8];
+  uint32_t version_;
+  uint32_t kind_count_;
+  uint64_t body_size_;
+  uint64_t body_hash_;
+};
+
+// FNV-1a
+static uint64_t hashBytes(const char* data, size_t size,
+                          uint64_t hash = 14695981039346656037ull) {
+  for (size_t index = 0; index < size; ++index) {
+    hash = (hash ^ static_cast<unsigned char>(data[index])) *
+           1099511628211ull;
+  }
+  return hash;
+}
+
+template <typename T>
+static void putValue(std::string& out, T value) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void putText(std::string& out, boost::string_ref text) {
+  putValue<uint32_t>(out, static_cast<uint32_t>(text.size()));
+  out.append(text.data(), text.size());
+}
+
+template <typename T>
+static bool getValue(const char*& cursor, const char* end, T& value) {
+  if (static_cast<size_t>(end - cursor) < sizeof(value)) {
+    return false;
+  }
+  std::memcpy(&value, cursor, sizeof(value));
+  cursor += sizeof(value);
+  return true;
+}
+
+static bool getText(const char*& cursor, const char* end,
+                    boost::string_ref& text) {
+  uint32_t size;
+  if ((!getValue(cursor, end, size)) ||
+      (static_cast<size_t>(end - cursor) < size)) {
+    return false;
+  }
+  text = boost::string_ref(cursor, size);
+  cursor += size;
+  return true;
+}
+
+/*
+ SymbolTable representing the symbols a cache file refers to, by their
+ index in the file since SymbolIDs differ from run to run
+ indexes_ - Index in the file of every symbol written
+ texts_ - Text of every symbol written, in index order
+ */
+struct SymbolTable {
+  uint32_t indexOf(SymbolID symbol) {
+    if (symbol == Token::no_payload) {
+      return Token::no_payload;
+    }
+    auto inserted = indexes_.emplace(symbol, texts_.size());
+    if (inserted.second) {
+      texts_.push_back(Interner::instance().getText(symbol));
+    }
+    return inserted.first->second;
+  }
+
+  std::unordered_map<SymbolID, uint32_t> indexes_;
+  std::vector<boost::string_ref> texts_;
+};
+
+static void putToken(std::string& out, const Token& token,
+                     SymbolTable& symbols) {
+  putValue<uint8_t>(out, static_cast<uint8_t>(token.getTokenKind()));
+  putValue<uint32_t>(out, token.getOffset());
+  putValue<uint32_t>(out, token.getLength());
+  putValue<uint32_t>(out, symbols.indexOf(token.getSymbol()));
+}
+
+static bool getSymbol(const std::vector<SymbolID>& symbols, uint32_t index,
+                      SymbolID& symbol) {
+  if (index == Token::no_payload) {
+    symbol = Token::no_payload;
+    return true;
+  }
+  if (index >= symbols.size()) {
+    return false;
+  }
+  symbol = symbols[index];
+  return true;
+}
+
+static bool getToken(const char*& cursor, const char* end, FileID file,
+                     const std::vector<SymbolID>& symbols, Token& token) {
+  uint8_t kind;
+  uint32_t offset, length, index;
+  SymbolID payload;
+  if ((!getValue(cursor, end, kind)) || (!getValue(cursor, end, offset)) ||
+      (!getValue(cursor, end, length)) || (!getValue(cursor, end, index)) ||
+      (kind > static_cast<uint8_t>(TokenKind::NOT_A_KIND)) ||
+      (offset + static_cast<uint64_t>(length) >
+       SourceManager::instance().getBuffer(file).size()) ||
+      (!getSymbol(symbols, index, payload))) {
+    return false;
+  }
+  token = Token(static_cast<TokenKind>(kind), file, offset, length, payload);
+  return true;
+}
+
+// the whole file, its tokens are copied into the entry anyway
+static bool readFile(const std::string& path, std::string& bytes) {
+  std::ifstream in(path, std::ios::binary);
+  if ((!in) || (!in.seekg(0, std::ios::end))) {
+    return false;
+  }
+  bytes.resize(static_cast<size_t>(in.tellg()));
+  in.seekg(0, std::ios::beg);
+  return static_cast<bool>(in.read(&bytes[0], bytes.size()));
+}
+
+TokenCache::TokenCache(const std::string& dir, uint32_t lexer_version)
+    : dir_(dir), lexer_version_(lexer_version) {
+  // a directory that can't be made just means nothing gets stored
+  boost::system::error_code ec;
+  boost::filesystem::create_directories(dir_, ec);
+}
+
+// body: symbols, tokens, includes, guard, output
+bool TokenCache::load(FileID file, const CompileUnit& unit,
+                      IncludeCache::Entry& entry) const {
+  std::string bytes;
+  if (!readFile(getPath(file, unit), bytes)) {
+    return false;
+  }
+
+  CacheHeader header;
+  const char* cursor = bytes.data();
+  const char* end = bytes.data() + bytes.size();
+  if ((!getValue(cursor, end, header)) ||
+      (std::memcmp(header.magic_, magic, sizeof(magic)) != 0) ||
+      (header.version_ != format_version) ||
+      (header.kind_count_ != static_cast<uint32_t>(TokenKind::NOT_A_KIND)) ||
+      (header.body_size_ != static_cast<uint64_t>(end - cursor)) ||
+      (header.body_hash_ != hashBytes(cursor, end - cursor))) {
+    return false;
+  }
+
+  uint32_t count;
+  if (!getValue(cursor, end, count)) {
+    return false;
+  }
+  std::vector<SymbolID> symbols;
+  for (uint32_t index = 0; index < count; ++index) {
+    boost::string_ref text;
+    if (!getText(cursor, end, text)) {
+      return false;
+    }
+    symbols.push_back(Interner::instance().intern(text));
+  }
+
+  std::vector<Token> tokens;
+  if (!getValue(cursor, end, count)) {
+    return false;
+  }
+  for (uint32_t index = 0; index < count; ++index) {
+    Token token;
+    if (!getToken(cursor, end, file, symbols, token)) {
+      return false;
+    }
+    tokens.push_back(token);
+  }
+
+  // included files are looked up and loaded again, one gone or shadowed by
+  // a file created since makes the file stale
+  std::string dir = boost::filesystem::path(
+                        SourceManager::instance().getFileName(file))
+                        .parent_path()
+                        .string();
+  std::vector<IncludeCache::Include> includes;
+  if (!getValue(cursor, end, count)) {
+    return false;
+  }
+  for (uint32_t index = 0; index < count; ++index) {
+    uint32_t token, out;
+    boost::string_ref path;
+    std::string found;
+    IncludeCache::Include included;
+    if ((!getValue(cursor, end, token)) || (!getValue(cursor, end, out)) ||
+        (!getText(cursor, end, path)) ||
+        (!getToken(cursor, end, file, symbols, included.filename_)) ||
+        (token > tokens.size()) ||
+        ((!includes.empty()) && ((token < includes.back().token_) ||
+                                 (out < includes.back().out_))) ||
+        (!HeaderSearch::instance().find(
+            unit.search_, dir, included.filename_.getContent().to_string(),
+            found)) ||
+        (found != path) ||
+        (!SourceManager::instance().loadFile(found, included.file_))) {
+      return false;
+    }
+    included.token_ = token;
+    included.error_ = 0;
+    included.out_ = out;
+    includes.push_back(included);
+  }
+
+  uint8_t once;
+  uint32_t index;
+  SymbolID macro;
+  boost::string_ref out;
+  if ((!getValue(cursor, end, once)) || (!getValue(cursor, end, index)) ||
+      (!getSymbol(symbols, index, macro)) || (!getText(cursor, end, out)) ||
+      ((!includes.empty()) && (includes.back().out_ > out.size())) ||
+      (cursor != end)) {
+    return false;
+  }
+
+  for (const auto& token : tokens) {
+    entry.tokens_.push(token);
+  }
+  entry.includes_ = std::move(includes);
+  entry.guard_ = (once != 0) ? (IncludeGuard(macro)) : (IncludeGuard());
+  entry.out_ = out.to_string();
+  return true;
+}
+
+void TokenCache::store(FileID file, const CompileUnit& unit,
+                       const IncludeCache::Entry& entry) const {
+  if (!entry.errors_.empty()) {
+    return;
+  }
+
+  SymbolTable symbols;
+  std::string tokens;
+  putValue<uint32_t>(tokens, static_cast<uint32_t>(entry.tokens_.size()));
+  for (size_t index = 0; index < entry.tokens_.size(); ++index) {
+    putToken(tokens, entry.tokens_[index], symbols);
+  }
+
+  std::string rest;
+  putValue<uint32_t>(rest, static_cast<uint32_t>(entry.includes_.size()));
+  for (const auto& included : entry.includes_) {
+    putValue<uint32_t>(rest, static_cast<uint32_t>(included.token_));
+    putValue<uint32_t>(rest, static_cast<uint32_t>(included.out_));
+    putText(rest, SourceManager::instance().getFileName(included.file_));
+    putToken(rest, included.filename_, symbols);
+  }
+  putValue<uint8_t>(rest, entry.guard_.isOnce() ? 1 : 0);
+  putValue<uint32_t>(rest, symbols.indexOf(entry.guard_.getMacro()));
+  putText(rest, entry.out_);
+
+  // the symbol table goes first, it is complete only now
+  std::string body;
+  putValue<uint32_t>(body, static_cast<uint32_t>(symbols.texts_.size()));
+  for (const auto& text : symbols.texts_) {
+    putText(body, text);
+  }
+  body += tokens;
+  body += rest;
+
+  CacheHeader header;
+  std::memcpy(header.magic_, magic, sizeof(magic));
+  header.version_ = format_version;
+  header.kind_count_ = static_cast<uint32_t>(TokenKind::NOT_A_KIND);
+  header.body_size_ = body.size();
+  header.body_hash_ = hashBytes(body.data(), body.size());
+
+  // written aside and renamed, so readers never see half a file
+  std::string path = getPath(file, unit);
+  std::ostringstream temp;
+  temp << path << "." << getpid() << "."
+       << std::hash<std::thread::id>()(std::this_thread::get_id())
+       << ".tmp";
+  {
+    std::ofstream out(temp.str(), std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(body.data(), body.size());
+    if (!out) {
+      out.close();
+      std::remove(temp.str().c_str());
+      return;
+    }
+  }
+  if (std::rename(temp.str().c_str(), path.c_str()) != 0) {
+    std::remove(temp.str().c_str());
+  }
+}
+
+std::string TokenCache::getPath(FileID file, const CompileUnit& unit) const {
+  const SourceManager& manager = SourceManager::instance();
+  const std::string& name = manager.getFileName(file);
+  const SourceBuffer& source = manager.getBuffer(file);
+
+  uint64_t key = hashBytes(reinterpret_cast<const char*>(&lexer_version_),
+                           sizeof(lexer_version_));
+  key = hashBytes(name.c_str(), name.size() + 1, key);
+  char flags = static_cast<char>(unit.dump_);
+  key = hashBytes(&flags, sizeof(flags), key);
+  for (const auto& dir : HeaderSearch::instance().getSearchList(unit.search_)) {
+    key = hashBytes(dir.c_str(), dir.size() + 1, key);
+  }
+  key = hashBytes(source.begin(), source.size(), key);
+
+  char file_name[32];
+  std::snprintf(file_name, sizeof(file_name), "%016llx.tok",
+                static_cast<unsigned long long>(key));
+  return (boost::filesystem::path(dir_) / file_name).string();
+}
@@ -0,0 +1,43 @@
+#include <cstdint>
+#include <string>
+
+#include "compile_unit.h"
+#include "include_cache.h"
+#include "lexer.h"
+#include "source_manager.h"
+
+#ifndef SRC_TOKEN_CACHE_H_
+#define SRC_TOKEN_CACHE_H_
+
+/*
+ TokenCache representing headers lexed by earlier runs, one file per header
+ in a directory. A file is named by a hash of Lexer::version, the path and
+ bytes of the header, the search list and the options changing its output,
+ and its body is checked against a hash of it when loaded. Its includes are
+ looked up again and must find the same files, so a stale or corrupt file
+ is never used and gets rewritten
+ dir_ - Directory the files are in
+ lexer_version_ - Lexer::version the files are keyed by
+ */
+class TokenCache {
+ public:
+  // another lexer_version sees none of the files of this one
+  explicit TokenCache(const std::string& dir,
+                      uint32_t lexer_version = Lexer::version);
+
+ public:
+  // false if there is no usable file for the header, entry is untouched
+  bool load(FileID file, const CompileUnit& unit,
+            IncludeCache::Entry& entry) const;
+  // headers with errors are lexed every run, errors aren't stored
+  void store(FileID file, const CompileUnit& unit,
+             const IncludeCache::Entry& entry) const;
+
+ private:
+  std::string getPath(FileID file, const CompileUnit& unit) const;
+
+ private:
+  std::string dir_;
+  uint32_t lexer_version_;
+};
+#endif  // SRC_TOKEN_CACHE_H_
@@ -0,0 +1,168 @@
+#include "token_dump.h"
+
+#include <cstring>
+
+static const size_t kind_prefix_size = std::strlen("TokenKind::");
+// text gathered before it is handed to the stream
+static constexpr size_t block_size = 64 * 1024;
+
+TokenWriter::TokenWriter(TokenDump dump, std::ostream& out)
+    : dump_(dump), out_(out), text_(), scratch_() {}
+
+TokenWriter::~TokenWriter() { flush(); }
+
+void TokenWriter::beginFile(FileID file) {
+  if (dump_ == TokenDump::NONE) {
+    return;
+  }
+  const std::string& name = SourceManager::instance().getFileName(file);
+  switch (dump_) {
+    case TokenDump::NONE:
+      break;
+    case TokenDump::TEXT:
+      text_ += "----- ----- < ";
+      text_ += name;
+      text_ += " tokens > ----- -----\n";
+      break;
+    case TokenDump::JSONL:
+      text_ += "{\"file\":";
+      appendJSON(name);
+      text_ += "}\n";
+      break;
+    case TokenDump::BIN:
+      appendRecord({DumpRecord::BEGIN_FILE, DumpRecord::kind_count,
+                    DumpRecord::version, 0, 0, 0},
+                   name);
+      break;
+  }
+}
+
+void TokenWriter::write(const Token& token, size_t line) {
+  switch (dump_) {
+    case TokenDump::NONE:
+      break;
+    case TokenDump::TEXT: {
+      boost::string_ref content = token.getContent();
+      boost::string_ref rep = token.getRep(scratch_);
+      text_ += "    [";
+      appendNumber(line);
+      text_ += "][";
+      text_ += TokenKindToStr(token.getTokenKind());
+      text_ += "] [";
+      text_.append(content.data(), content.size());
+      text_ += "] [";
+      text_.append(rep.data(), rep.size());
+      text_ += "]\n";
+      break;
+    }
+    case TokenDump::JSONL:
+      text_ += "{\"kind\":\"";
+      // without the "TokenKind::" all the names start with
+      text_ += TokenKindToStr(token.getTokenKind()) + kind_prefix_size;
+      text_ += "\",\"offset\":";
+      appendNumber(token.getOffset());
+      text_ += ",\"length\":";
+      appendNumber(token.getLength());
+      text_ += ",\"value\":";
+      appendJSON(token.getContent());
+      text_ += "}\n";
+      break;
+    case TokenDump::BIN: {
+      // keywords and punctuators are spelled by their kind
+      boost::string_ref value;
+      if (token.getTokenKind() < TokenKind::KEY_BOOL) {
+        value = token.getContent();
+      }
+      appendRecord({DumpRecord::TOKEN,
+                    static_cast<uint8_t>(token.getTokenKind()), 0,
+                    token.getOffset(), token.getLength(), 0},
+                   value);
+      break;
+    }
+  }
+  if (text_.size() >= block_size) {
+    flush();
+  }
+}
+
+void TokenWriter::endFile(FileID file) {
+  switch (dump_) {
+    case TokenDump::NONE:
+      break;
+    case TokenDump::TEXT:
+      text_ += "----- ----- ----- <  > ----- ----- -----\n";
+      break;
+    case TokenDump::JSONL:
+      text_ += "{\"end\":";
+      appendJSON(SourceManager::instance().getFileName(file));
+      text_ += "}\n";
+      break;
+    case TokenDump::BIN:
+      appendRecord({DumpRecord::END_FILE, 0, 0, 0, 0, 0}, "");
+      break;
+  }
+}
+
+void TokenWriter::flush() {
+  if (!text_.empty()) {
+    out_.write(text_.data(), text_.size());
+    text_.clear();
+  }
+}
+
+bool TokenWriter::findFormat(const std::string& name, TokenDump& dump) {
+  if (name == "text") {
+    dump = TokenDump::TEXT;
+  } else if (name == "jsonl") {
+    dump = TokenDump::JSONL;
+  } else if (name == "bin") {
+    dump = TokenDump::BIN;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void TokenWriter::appendNumber(size_t number) {
+  char digits[24];
+  char* first = digits + sizeof(digits);
+  do {
+    *--first = static_cast<char>('0' + number % 10);
+    number /= 10;
+  } while (number > 0);
+  text_.append(first, digits + sizeof(digits));
+}
+
+// bytes from 0x80 up go as they are, sources are taken to be UTF-8
+void TokenWriter::appendJSON(boost::string_ref text) {
+  static const char hex[] = "0123456789abcdef";
+  text_ += '"';
+  for (char c : text) {
+    unsigned char byte = static_cast<unsigned char>(c);
+    if ((c == '"') || (c == '\\')) {
+      text_ += '\\';
+      text_ += c;
+    } else if (c == '\n') {
+      text_ += "\\n";
+    } else if (c == '\t') {
+      text_ += "\\t";
+    } else if (byte < 0x20) {
+      text_ += "\\u00";
+      text_ += hex[byte >> 4];
+      text_ += hex[byte & 0xf];
+    } else {
+      text_ += c;
+    }
+  }
+  text_ += '"';
+}
+
+void TokenWriter::appendRecord(const DumpRecord& record,
+                               boost::string_ref payload) {
+  DumpRecord sized = record;
+  sized.size_ = static_cast<uint32_t>(payload.size());
+  text_.append(reinterpret_cast<const char*>(&sized), sizeof(sized));
+  text_.append(payload.data(), payload.size());
+  // the next record starts aligned
+  text_.append((4 - payload.size() % 4) % 4, '\0');
+}
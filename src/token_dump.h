@@ -0,0 +1,101 @@
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include <boost/utility/string_ref.hpp>
+
+#include "source_manager.h"
+#include "tokens.h"
+
+#ifndef SRC_TOKEN_DUMP_H_
+#define SRC_TOKEN_DUMP_H_
+
+/*
+ TokenDump representing the format the tokens of every file are printed in
+ NONE - Tokens aren't printed
+ TEXT - Lines for people to read, a header and a footer around every file
+ JSONL - One JSON object a line: {"file":NAME} begins a file,
+         {"kind":KIND,"offset":N,"length":N,"value":TEXT} is a token, KIND
+         a TokenKind name such as "SB_SEMI", and {"end":NAME} ends the file
+         begun last
+ BIN - DumpRecords, read in place from a mapped file
+ */
+enum class TokenDump : uint8_t { NONE = 0, TEXT, JSONL, BIN };
+
+/*
+ DumpRecord representing one record of the bin format. Fields are in host
+ byte order and every record starts on a 4 byte boundary, its payload
+ follows it padded with zeros to the next one. Included files are nested
+ between the records of the file including them
+ type_ - BEGIN_FILE, TOKEN or END_FILE, which ends the file begun last
+ kind_ - TokenKind of a token, numbered as tokens.h declares them. Of a
+         BEGIN_FILE the number of TokenKinds of the writer, which changes
+         when kinds are added or renumbered, so a reader can tell whether
+         its own table matches. 0 otherwise
+ version_ - Format version of a BEGIN_FILE, 0 otherwise
+ offset_ - Byte offset of the first byte of a token in its file, 0 otherwise
+ length_ - Number of source bytes a token spans, 0 otherwise
+ size_ - Bytes of payload, without padding: the name of the file for a
+         BEGIN_FILE, the value of an identifier, number, string, char or
+         include filename, nothing for keywords and punctuators as their
+         kind spells them
+ */
+struct DumpRecord {
+  static constexpr uint8_t BEGIN_FILE = 0;
+  static constexpr uint8_t TOKEN = 1;
+  static constexpr uint8_t END_FILE = 2;
+  static constexpr uint16_t version = 2;
+  static constexpr uint8_t kind_count =
+      static_cast<uint8_t>(TokenKind::NOT_A_KIND);
+
+  uint8_t type_;
+  uint8_t kind_;
+  uint16_t version_;
+  uint32_t offset_;
+  uint32_t length_;
+  uint32_t size_;
+};
+static_assert(sizeof(DumpRecord) == 16, "DumpRecord is read in place");
+static_assert(static_cast<size_t>(TokenKind::NOT_A_KIND) <= UINT8_MAX,
+              "every TokenKind fits kind_");
+
+/*
+ TokenWriter representing the tokens of one file printed in a TokenDump
+ format. Text is put together in memory and handed to the stream a block
+ at a time or on flush, the stream is never flushed
+ dump_ - Format, NONE to print nothing
+ out_ - Stream written to
+ text_ - Text not written yet
+ scratch_ - Spelling of a string split by a line splice, put together again
+ */
+class TokenWriter {
+ public:
+  TokenWriter(TokenDump dump, std::ostream& out);
+  ~TokenWriter();
+
+  TokenWriter(const TokenWriter&) = delete;
+  TokenWriter& operator=(const TokenWriter&) = delete;
+
+ public:
+  void beginFile(FileID file);
+  // line is the number of lines lexed before, only the text format has it
+  void write(const Token& token, size_t line);
+  void endFile(FileID file);
+  // hand what is gathered to the stream, before anything else writes to it
+  void flush();
+
+  // format spelled name, false if there is none
+  static bool findFormat(const std::string& name, TokenDump& dump);
+
+ private:
+  void appendNumber(size_t number);
+  void appendJSON(boost::string_ref text);
+  void appendRecord(const DumpRecord& record, boost::string_ref payload);
+
+ private:
+  TokenDump dump_;
+  std::ostream& out_;
+  std::string text_;
+  std::string scratch_;
+};
+#endif  // SRC_TOKEN_DUMP_H_
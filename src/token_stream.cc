@@ -0,0 +1,79 @@
+#include "token_stream.h"
+
+#include <algorithm>
+
+TokenStream::TokenStream(FileID file, Arena& arena)
+    : kinds_(ArenaAllocator<TokenKind>(arena)),
+      offsets_(ArenaAllocator<uint32_t>(arena)),
+      lengths_(ArenaAllocator<uint32_t>(arena)),
+      payloads_(ArenaAllocator<uint32_t>(arena)),
+      file_runs_(ArenaAllocator<FileRun>(arena)) {
+  file_runs_.push_back({0, file});
+}
+
+size_t TokenStream::size() const { return kinds_.size(); }
+
+bool TokenStream::empty() const { return kinds_.empty(); }
+
+void TokenStream::push(const Token& token) {
+  startRun(token.getFileID());
+  kinds_.push_back(token.getTokenKind());
+  offsets_.push_back(token.getOffset());
+  lengths_.push_back(token.getLength());
+  payloads_.push_back(token.getSymbol());
+}
+
+void TokenStream::truncate(size_t count) {
+  if (count >= size()) {
+    return;
+  }
+
+  kinds_.resize(count);
+  offsets_.resize(count);
+  lengths_.resize(count);
+  payloads_.resize(count);
+  while ((file_runs_.size() > 1) && (file_runs_.back().first_ >= count)) {
+    file_runs_.pop_back();
+  }
+}
+
+void TokenStream::append(const TokenStream& other, size_t first,
+                         size_t last) {
+  for (size_t index = first; index < last; ++index) {
+    push(other[index]);
+  }
+}
+
+Token TokenStream::operator[](size_t index) const {
+  return Token(kinds_[index], getFileID(index), offsets_[index],
+               lengths_[index], payloads_[index]);
+}
+
+TokenKind TokenStream::getTokenKind(size_t index) const {
+  return kinds_[index];
+}
+
+SymbolID TokenStream::getSymbol(size_t index) const {
+  return payloads_[index];
+}
+
+FileID TokenStream::getFileID(size_t index) const {
+  auto next_run =
+      std::upper_bound(file_runs_.begin(), file_runs_.end(), index,
+                       [](size_t index, const FileRun& run) {
+                         return index < run.first_;
+                       });
+  return (next_run - 1)->file_;
+}
+
+void TokenStream::startRun(FileID file) {
+  if (file_runs_.back().file_ == file) {
+    return;
+  }
+  // a run nothing was pushed to yet is taken over
+  if (file_runs_.back().first_ == size()) {
+    file_runs_.back().file_ = file;
+  } else {
+    file_runs_.push_back({static_cast<uint32_t>(size()), file});
+  }
+}
@@ -0,0 +1,58 @@
+#include <cstdint>
+#include <vector>
+
+#include "arena.h"
+#include "errors.h"
+#include "interner.h"
+#include "source_manager.h"
+#include "tokens.h"
+
+#ifndef SRC_TOKEN_STREAM_H_
+#define SRC_TOKEN_STREAM_H_
+
+/*
+ TokenStream representing a sequence of tokens stored as struct-of-arrays,
+ all of it allocated from the arena of the translation unit
+ kinds_, offsets_, lengths_, payloads_ - One column per field of a Token
+ file_runs_ - File of every run of consecutive tokens from the same file
+ */
+class TokenStream {
+ public:
+  TokenStream(FileID file, Arena& arena);
+
+ public:
+  size_t size() const;
+  bool empty() const;
+
+  void push(const Token& token);
+  // drop the tokens from count on
+  void truncate(size_t count);
+  // append the tokens [first, last) of other
+  void append(const TokenStream& other, size_t first, size_t last);
+
+  Token operator[](size_t index) const;
+  TokenKind getTokenKind(size_t index) const;
+  SymbolID getSymbol(size_t index) const;
+  FileID getFileID(size_t index) const;
+
+ private:
+  /*
+   FileRun representing consecutive tokens from one file
+   first_ - Index of the first token of the run
+   file_ - File of the tokens of the run
+   */
+  struct FileRun {
+    uint32_t first_;
+    FileID file_;
+  };
+
+  void startRun(FileID file);
+
+ private:
+  ArenaVector<TokenKind> kinds_;
+  ArenaVector<uint32_t> offsets_;
+  ArenaVector<uint32_t> lengths_;
+  ArenaVector<uint32_t> payloads_;
+  ArenaVector<FileRun> file_runs_;
+};
+#endif  // SRC_TOKEN_STREAM_H_
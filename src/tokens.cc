@@ -1,144 +1,318 @@
 #include "tokens.h"
 
-#include <cctype>
-#include <regex>
-#include <sstream>
-
-const std::vector<TokenPair> Token::keyword_kinds_{
-    {TokenKind::KEY_BOOL, "_Bool"},        {TokenKind::KEY_CHAR, "char"},
-    {TokenKind::KEY_SHORT, "short"},       {TokenKind::KEY_INT, "int"},
-    {TokenKind::KEY_LONG, "long"},         {TokenKind::KEY_SIGNED, "signed"},
-    {TokenKind::KEY_UNSIGNED, "unsigned"}, {TokenKind::KEY_VOID, "void"},
-    {TokenKind::KEY_RETURN, "return"},     {TokenKind::KEY_IF, "if"},
-    {TokenKind::KEY_ELSE, "else"},         {TokenKind::KEY_WHILE, "while"},
-    {TokenKind::KEY_FOR, "for"},           {TokenKind::KEY_BREAK, "break"},
-    {TokenKind::KEY_CONTINUE, "continue"}, {TokenKind::KEY_AUTO, "auto"},
-    {TokenKind::KEY_STATIC, "static"},     {TokenKind::KEY_EXTERN, "extern"},
-    {TokenKind::KEY_STRUCT, "struct"},     {TokenKind::KEY_UNION, "union"},
-    {TokenKind::KEY_CONST, "const"},       {TokenKind::KEY_TYPEDEF, "typedef"},
-    {TokenKind::KEY_SIZEOF, "sizeof"}};
-
-const std::vector<TokenPair> Token::symbol_kinds_{
-    {TokenKind::SB_ADD, "+"},     {TokenKind::SB_MIN, "-"},
-    {TokenKind::SB_MUL, "*"},     {TokenKind::SB_DIV, "/"},
-    {TokenKind::SB_MOD, "%"},     {TokenKind::SB_INC, "++"},
-    {TokenKind::SB_DEC, "--"},    {TokenKind::SB_EQU, "="},
-    {TokenKind::SB_EQUADD, "+="}, {TokenKind::SB_EQUMIN, "-="},
-    {TokenKind::SB_EQUMUL, "*="}, {TokenKind::SB_EQUDIV, "/="},
-    {TokenKind::SB_EQUMOD, "%="}, {TokenKind::SB_EQ, "=="},
-    {TokenKind::SB_NE, "!="},     {TokenKind::SB_LOGAND, "&&"},
-    {TokenKind::SB_LOGOR, "||"},  {TokenKind::SB_NOT, "!"},
-    {TokenKind::SB_LT, "<"},      {TokenKind::SB_GT, ">"},
-    {TokenKind::SB_LE, "<="},     {TokenKind::SB_GE, ">="},
-    {TokenKind::SB_AND, "&"},     {TokenKind::SB_POUND, "#"},
-    {TokenKind::SB_SAL, "<<"},    {TokenKind::SB_SAR, ">>"},
-    {TokenKind::SB_NEG, "~"},     {TokenKind::SB_DQUOTE, "\""},
-    {TokenKind::SB_SQUOTE, "'"},  {TokenKind::SB_LL_BCT, "("},
-    {TokenKind::SB_RL_BCT, ")"},  {TokenKind::SB_LB_BCT, "{"},
-    {TokenKind::SB_RB_BCT, "}"},  {TokenKind::SB_LM_BCT, "["},
-    {TokenKind::SB_RM_BCT, "]"},  {TokenKind::SB_COMMA, ","},
-    {TokenKind::SB_SEMI, ";"},    {TokenKind::SB_DOT, "."},
-    {TokenKind::SB_ARROW, "->"}};
-
-Token::Token(const TokenKind& kind, const std::string& content,
-             const std::string& rep, std::shared_ptr<Range> range)
-    : kind_(kind), content_(content), rep_(rep), range_(range) {
-  tokenPairInit();
-}
+#include <cstdint>
+#include <cstring>
+#include <string>
 
-TokenKind Token::getTokenKind() const { return kind_; }
+#include "char_class.h"
 
-std::string Token::getContent() const { return content_; }
+/*
+ KindSpelling representing how a keyword or symbol is written
+ kind_ - Kind of the keyword or symbol
+ text_ - Spelling of the keyword or symbol
+ */
+struct KindSpelling {
+  TokenKind kind_;
+  const char* text_;
+};
 
-std::string Token::getRep() const { return rep_; }
+static constexpr KindSpelling keyword_kinds[]{
+    {TokenKind::KEY_BOOL, "_Bool"},
+    {TokenKind::KEY_CHAR, "char"},
+    {TokenKind::KEY_SHORT, "short"},
+    {TokenKind::KEY_INT, "int"},
+    {TokenKind::KEY_LONG, "long"},
+    {TokenKind::KEY_SIGNED, "signed"},
+    {TokenKind::KEY_UNSIGNED, "unsigned"},
+    {TokenKind::KEY_VOID, "void"},
+    {TokenKind::KEY_RETURN, "return"},
+    {TokenKind::KEY_IF, "if"},
+    {TokenKind::KEY_ELSE, "else"},
+    {TokenKind::KEY_WHILE, "while"},
+    {TokenKind::KEY_FOR, "for"},
+    {TokenKind::KEY_BREAK, "break"},
+    {TokenKind::KEY_CONTINUE, "continue"},
+    {TokenKind::KEY_AUTO, "auto"},
+    {TokenKind::KEY_STATIC, "static"},
+    {TokenKind::KEY_EXTERN, "extern"},
+    {TokenKind::KEY_STRUCT, "struct"},
+    {TokenKind::KEY_UNION, "union"},
+    {TokenKind::KEY_CONST, "const"},
+    {TokenKind::KEY_TYPEDEF, "typedef"},
+    {TokenKind::KEY_SIZEOF, "sizeof"},
+    {TokenKind::KEY_SWITCH, "switch"},
+    {TokenKind::KEY_CASE, "case"},
+    {TokenKind::KEY_DEFAULT, "default"},
+    {TokenKind::KEY_DO, "do"},
+    {TokenKind::KEY_GOTO, "goto"},
+    {TokenKind::KEY_ENUM, "enum"},
+    {TokenKind::KEY_FLOAT, "float"},
+    {TokenKind::KEY_DOUBLE, "double"},
+    {TokenKind::KEY_VOLATILE, "volatile"},
+    {TokenKind::KEY_RESTRICT, "restrict"},
+    {TokenKind::KEY_INLINE, "inline"},
+    {TokenKind::KEY_REGISTER, "register"},
+    {TokenKind::KEY_ALIGNAS, "_Alignas"},
+    {TokenKind::KEY_ALIGNOF, "_Alignof"},
+    {TokenKind::KEY_ATOMIC, "_Atomic"},
+    {TokenKind::KEY_COMPLEX, "_Complex"},
+    {TokenKind::KEY_GENERIC, "_Generic"},
+    {TokenKind::KEY_IMAGINARY, "_Imaginary"},
+    {TokenKind::KEY_NORETURN, "_Noreturn"},
+    {TokenKind::KEY_STATIC_ASSERT, "_Static_assert"},
+    {TokenKind::KEY_THREAD_LOCAL, "_Thread_local"}};
 
-std::shared_ptr<Range> Token::getRange() const { return range_; }
+static constexpr size_t spellingLength(const char* text) {
+  size_t length = 0;
+  while (text[length] != '\0') {
+    ++length;
+  }
+  return length;
+}
+
+// perfect over keyword_kinds, checked by static_assert below
+static constexpr size_t keyword_slot_count = 128;
+
+static constexpr size_t keywordHash(const char* begin, size_t length) {
+  return (2 * static_cast<unsigned char>(begin[0]) +
+          39 * static_cast<unsigned char>(begin[length - 1]) + 13 * length) &
+         (keyword_slot_count - 1);
+}
 
-void Token::tokenPairInit() {
-  if (((kind_ != TokenKind::NOT_A_KIND) && (content_.compare(""))) ||
-      ((kind_ == TokenKind::NOT_A_KIND) && (!content_.compare(""))) ||
-      (kind_ <= TokenKind::INCLUDE)) {
-    return;
+/*
+ KeywordTable representing keyword_kinds placed by keywordHash
+ text_ - Spelling in each slot, nullptr for an empty slot
+ length_ - Length of the spelling in each slot, 0 for an empty slot
+ kind_ - Kind of the keyword in each slot
+ max_length_ - Length of the longest keyword
+ collision_ - True if two keywords hash to the same slot
+ */
+struct KeywordTable {
+  const char* text_[keyword_slot_count];
+  size_t length_[keyword_slot_count];
+  TokenKind kind_[keyword_slot_count];
+  size_t max_length_;
+  bool collision_;
+};
+
+static constexpr KeywordTable buildKeywordTable() {
+  KeywordTable table{};
+  for (auto& kind : table.kind_) {
+    kind = TokenKind::NOT_A_KIND;
   }
 
-  for (const auto& tp : keyword_kinds_) {
-    if (kind_ == TokenKind::NOT_A_KIND) {
-      kind_ = (!content_.compare(tp.second)) ? (tp.first) : (kind_);
-    } else if (!content_.compare("")) {
-      content_ = (kind_ == tp.first) ? (tp.second) : (content_);
-    }
+  for (const auto& keyword : keyword_kinds) {
+    size_t length = spellingLength(keyword.text_);
+    size_t slot = keywordHash(keyword.text_, length);
+    table.collision_ = table.collision_ || (table.length_[slot] != 0);
+    table.text_[slot] = keyword.text_;
+    table.length_[slot] = length;
+    table.kind_[slot] = keyword.kind_;
+    table.max_length_ =
+        (length > table.max_length_) ? (length) : (table.max_length_);
   }
+  return table;
+}
 
-  for (const auto& tp : symbol_kinds_) {
-    if (kind_ == TokenKind::NOT_A_KIND) {
-      kind_ = (!content_.compare(tp.second)) ? (tp.first) : (kind_);
-    } else if (!content_.compare("")) {
-      content_ = (kind_ == tp.first) ? (tp.second) : (content_);
+static constexpr KeywordTable keyword_table = buildKeywordTable();
+static_assert(!keyword_table.collision_, "keywordHash must be perfect");
+
+static constexpr KindSpelling symbol_kinds[]{
+    {TokenKind::SB_ADD, "+"},       {TokenKind::SB_MIN, "-"},
+    {TokenKind::SB_MUL, "*"},       {TokenKind::SB_DIV, "/"},
+    {TokenKind::SB_MOD, "%"},       {TokenKind::SB_INC, "++"},
+    {TokenKind::SB_DEC, "--"},      {TokenKind::SB_EQU, "="},
+    {TokenKind::SB_EQUADD, "+="},   {TokenKind::SB_EQUMIN, "-="},
+    {TokenKind::SB_EQUMUL, "*="},   {TokenKind::SB_EQUDIV, "/="},
+    {TokenKind::SB_EQUMOD, "%="},   {TokenKind::SB_EQ, "=="},
+    {TokenKind::SB_NE, "!="},       {TokenKind::SB_LOGAND, "&&"},
+    {TokenKind::SB_LOGOR, "||"},    {TokenKind::SB_NOT, "!"},
+    {TokenKind::SB_LT, "<"},        {TokenKind::SB_GT, ">"},
+    {TokenKind::SB_LE, "<="},       {TokenKind::SB_GE, ">="},
+    {TokenKind::SB_AND, "&"},       {TokenKind::SB_POUND, "#"},
+    {TokenKind::SB_SAL, "<<"},      {TokenKind::SB_SAR, ">>"},
+    {TokenKind::SB_NEG, "~"},       {TokenKind::SB_DQUOTE, "\""},
+    {TokenKind::SB_SQUOTE, "'"},    {TokenKind::SB_LL_BCT, "("},
+    {TokenKind::SB_RL_BCT, ")"},    {TokenKind::SB_LB_BCT, "{"},
+    {TokenKind::SB_RB_BCT, "}"},    {TokenKind::SB_LM_BCT, "["},
+    {TokenKind::SB_RM_BCT, "]"},    {TokenKind::SB_COMMA, ","},
+    {TokenKind::SB_SEMI, ";"},      {TokenKind::SB_DOT, "."},
+    {TokenKind::SB_ARROW, "->"},    {TokenKind::SB_EQUSAL, "<<="},
+    {TokenKind::SB_EQUSAR, ">>="},  {TokenKind::SB_EQUAND, "&="},
+    {TokenKind::SB_OR, "|"},        {TokenKind::SB_EQUOR, "|="},
+    {TokenKind::SB_XOR, "^"},       {TokenKind::SB_EQUXOR, "^="},
+    {TokenKind::SB_ELLIPSIS, "..."}, {TokenKind::SB_QUES, "?"},
+    {TokenKind::SB_COLON, ":"}};
+
+// one state for the start plus at most one per character of every spelling
+static constexpr size_t symbolStateCount() {
+  size_t count = 1;
+  for (const auto& symbol : symbol_kinds) {
+    for (const char* c = symbol.text_; *c != '\0'; ++c) {
+      ++count;
     }
   }
+  return count;
 }
 
-TokenPair Token::findSymbolKind(const std::vector<Tagged>& taggedline,
-                                size_t start_index) {
-  // size_t maxLength = 0;
-  TokenPair tp = {TokenKind::NOT_A_KIND, ""};
-  for (const auto& symbolkind : symbol_kinds_) {
-    size_t length = 0;
-    for (const auto& c : symbolkind.second) {
-      if (((length + start_index) < taggedline.size()) &&
-          (taggedline[length + start_index].getC() == c)) {
-        ++length;
-        continue;
+static constexpr size_t symbol_state_count = symbolStateCount();
+static_assert(symbol_state_count <= 256, "symbol states must fit in a byte");
+
+/*
+ SymbolDfa representing a trie over symbol_kinds, walked one byte at a time
+ next_ - Next state for a state and byte, 0 if there is none
+ accept_ - Kind of the symbol spelled by reaching a state, or NOT_A_KIND
+ */
+struct SymbolDfa {
+  uint8_t next_[symbol_state_count][256];
+  TokenKind accept_[symbol_state_count];
+};
+
+static constexpr SymbolDfa buildSymbolDfa() {
+  SymbolDfa dfa{};
+  for (auto& accept : dfa.accept_) {
+    accept = TokenKind::NOT_A_KIND;
+  }
+
+  size_t states = 1;
+  for (const auto& symbol : symbol_kinds) {
+    size_t state = 0;
+    for (const char* c = symbol.text_; *c != '\0'; ++c) {
+      unsigned char uc = static_cast<unsigned char>(*c);
+      if (dfa.next_[state][uc] == 0) {
+        dfa.next_[state][uc] = static_cast<uint8_t>(states++);
       }
-      break;
+      state = dfa.next_[state][uc];
     }
-    if ((length == symbolkind.second.size()) && (length > tp.second.size())) {
-      tp = symbolkind;
+    dfa.accept_[state] = symbol.kind_;
+  }
+  return dfa;
+}
+
+static constexpr SymbolDfa symbol_dfa = buildSymbolDfa();
+
+constexpr uint32_t Token::no_payload;
+
+// strings and chars have a value besides their spelling
+static bool hasValue(TokenKind kind) {
+  return (kind == TokenKind::STRING) || (kind == TokenKind::CHAR);
+}
+
+// a backslash right before a newline always splices two lines
+static bool hasSplice(boost::string_ref text) {
+  for (size_t index = 1; index < text.size(); ++index) {
+    if ((text[index] == '\n') && (text[index - 1] == '\\')) {
+      return true;
     }
   }
-  return tp;
+  return false;
 }
 
-TokenPair Token::findKeyWordKind(const std::vector<Tagged>& taggedline,
-                                 size_t start_index, size_t end_index) {
-  std::string word = "";
-  for (; start_index < end_index; ++start_index) {
-    word += std::string(1, taggedline[start_index].getC());
+Token::Token(TokenKind kind, FileID file, uint32_t offset, uint32_t length,
+             uint32_t payload)
+    : kind_(kind),
+      file_(file),
+      offset_(offset),
+      length_(length),
+      payload_(payload) {}
+
+TokenKind Token::getTokenKind() const { return kind_; }
+
+FileID Token::getFileID() const { return file_; }
+
+uint32_t Token::getOffset() const { return offset_; }
+
+uint32_t Token::getLength() const { return length_; }
+
+SymbolID Token::getSymbol() const { return payload_; }
+
+Range Token::getRange() const {
+  return Range(Position(file_, offset_),
+               Position(file_, offset_ + length_ - 1));
+}
+
+boost::string_ref Token::getSpelling(std::string& scratch) const {
+  if ((payload_ != no_payload) && (!hasValue(kind_))) {
+    return Interner::instance().getText(payload_);
+  }
+
+  const SourceBuffer& buffer = SourceManager::instance().getBuffer(file_);
+  boost::string_ref source(buffer.begin() + offset_, length_);
+  if ((!hasValue(kind_)) || (!hasSplice(source))) {
+    return source;
   }
 
-  for (const auto& keyword_kind : keyword_kinds_) {
-    if (!keyword_kind.second.compare(word)) {
-      return keyword_kind;
+  // only dumps ask for the spelling of a spliced string, rebuild it then
+  scratch.clear();
+  for (size_t index = 0; index < source.size(); ++index) {
+    if ((source[index] == '\\') && (index + 1 < source.size()) &&
+        (source[index + 1] == '\n')) {
+      ++index;
+    } else {
+      scratch += source[index];
     }
   }
-  return {TokenKind::NOT_A_KIND, ""};
+  return scratch;
+}
+
+boost::string_ref Token::getContent() const {
+  if (hasValue(kind_)) {
+    return Interner::instance().getText(payload_);
+  }
+  // only strings and chars are ever put together
+  std::string unused;
+  return getSpelling(unused);
+}
+
+boost::string_ref Token::getRep(std::string& scratch) const {
+  if (hasValue(kind_)) {
+    return getSpelling(scratch);
+  }
+  return boost::string_ref();
 }
 
-std::string Token::findNumber(const std::vector<Tagged>& taggedline,
-                              size_t start_index, size_t end_index) {
-  std::string number = "";
-  for (; start_index < end_index; ++start_index) {
-    if (!isdigit(taggedline[start_index].getC())) {
-      return "";
+size_t Token::matchSymbol(const char* begin, const char* end,
+                          TokenKind& kind) {
+  kind = TokenKind::NOT_A_KIND;
+  size_t length = 0;
+  size_t state = 0;
+  for (const char* c = begin; c < end; ++c) {
+    state = symbol_dfa.next_[state][static_cast<unsigned char>(*c)];
+    if (state == 0) {
+      break;
+    }
+    if (symbol_dfa.accept_[state] != TokenKind::NOT_A_KIND) {
+      kind = symbol_dfa.accept_[state];
+      length = c - begin + 1;
     }
-    number += std::string(1, taggedline[start_index].getC());
   }
-  return number;
+  return length;
 }
 
-std::string Token::findIdentifier(const std::vector<Tagged>& taggedline,
-                                  size_t start_index, size_t end_index) {
-  std::string id = "";
-  for (; start_index < end_index; ++start_index) {
-    id += std::string(1, taggedline[start_index].getC());
+TokenKind Token::findKeyWordKind(const char* begin, const char* end) {
+  size_t length = end - begin;
+  if ((length == 0) || (length > keyword_table.max_length_)) {
+    return TokenKind::NOT_A_KIND;
   }
 
-  std::regex re("[_a-zA-Z][_a-zA-Z0-9]*$");
-  id = (std::regex_match(id, re)) ? id : "";
-  return id;
+  size_t slot = keywordHash(begin, length);
+  if ((keyword_table.length_[slot] == length) &&
+      (memcmp(keyword_table.text_[slot], begin, length) == 0)) {
+    return keyword_table.kind_[slot];
+  }
+  return TokenKind::NOT_A_KIND;
+}
+
+bool Token::isNumber(const char* begin, const char* end) {
+  return (begin != end) && (skipCharClass(begin, end, CHAR_DIGIT) == end);
 }
 
-static const char* TokenKindToStr(TokenKind tk) {
+bool Token::isIdentifier(const char* begin, const char* end) {
+  return (begin != end) && (isIdentStartChar(*begin)) &&
+         (skipIdentChars(begin + 1, end) == end);
+}
+
+const char* TokenKindToStr(TokenKind tk) {
   {
 #define TOKENKIND_TO_STR(x) \
   case x:                   \
@@ -174,6 +348,27 @@ static const char* TokenKindToStr(TokenKind tk) {
       TOKENKIND_TO_STR(TokenKind::KEY_CONST)
       TOKENKIND_TO_STR(TokenKind::KEY_TYPEDEF)
       TOKENKIND_TO_STR(TokenKind::KEY_SIZEOF)
+      TOKENKIND_TO_STR(TokenKind::KEY_SWITCH)
+      TOKENKIND_TO_STR(TokenKind::KEY_CASE)
+      TOKENKIND_TO_STR(TokenKind::KEY_DEFAULT)
+      TOKENKIND_TO_STR(TokenKind::KEY_DO)
+      TOKENKIND_TO_STR(TokenKind::KEY_GOTO)
+      TOKENKIND_TO_STR(TokenKind::KEY_ENUM)
+      TOKENKIND_TO_STR(TokenKind::KEY_FLOAT)
+      TOKENKIND_TO_STR(TokenKind::KEY_DOUBLE)
+      TOKENKIND_TO_STR(TokenKind::KEY_VOLATILE)
+      TOKENKIND_TO_STR(TokenKind::KEY_RESTRICT)
+      TOKENKIND_TO_STR(TokenKind::KEY_INLINE)
+      TOKENKIND_TO_STR(TokenKind::KEY_REGISTER)
+      TOKENKIND_TO_STR(TokenKind::KEY_ALIGNAS)
+      TOKENKIND_TO_STR(TokenKind::KEY_ALIGNOF)
+      TOKENKIND_TO_STR(TokenKind::KEY_ATOMIC)
+      TOKENKIND_TO_STR(TokenKind::KEY_COMPLEX)
+      TOKENKIND_TO_STR(TokenKind::KEY_GENERIC)
+      TOKENKIND_TO_STR(TokenKind::KEY_IMAGINARY)
+      TOKENKIND_TO_STR(TokenKind::KEY_NORETURN)
+      TOKENKIND_TO_STR(TokenKind::KEY_STATIC_ASSERT)
+      TOKENKIND_TO_STR(TokenKind::KEY_THREAD_LOCAL)
       // SYMBOL
       TOKENKIND_TO_STR(TokenKind::SB_ADD)
       TOKENKIND_TO_STR(TokenKind::SB_MIN)
@@ -214,6 +409,16 @@ static const char* TokenKindToStr(TokenKind tk) {
       TOKENKIND_TO_STR(TokenKind::SB_SEMI)
       TOKENKIND_TO_STR(TokenKind::SB_DOT)
       TOKENKIND_TO_STR(TokenKind::SB_ARROW)
+      TOKENKIND_TO_STR(TokenKind::SB_EQUSAL)
+      TOKENKIND_TO_STR(TokenKind::SB_EQUSAR)
+      TOKENKIND_TO_STR(TokenKind::SB_EQUAND)
+      TOKENKIND_TO_STR(TokenKind::SB_OR)
+      TOKENKIND_TO_STR(TokenKind::SB_EQUOR)
+      TOKENKIND_TO_STR(TokenKind::SB_XOR)
+      TOKENKIND_TO_STR(TokenKind::SB_EQUXOR)
+      TOKENKIND_TO_STR(TokenKind::SB_ELLIPSIS)
+      TOKENKIND_TO_STR(TokenKind::SB_QUES)
+      TOKENKIND_TO_STR(TokenKind::SB_COLON)
       // not a kind
       TOKENKIND_TO_STR(TokenKind::NOT_A_KIND)
     }
@@ -224,8 +429,9 @@ static const char* TokenKindToStr(TokenKind tk) {
 }
 
 std::ostream& operator<<(std::ostream& os, const Token& tk) {
+  std::string scratch;
   os << "[" << TokenKindToStr(tk.kind_) << "] "
-     << "[" << tk.content_ << "] "
-     << "[" << tk.rep_ << "]";
+     << "[" << tk.getContent() << "] "
+     << "[" << tk.getRep(scratch) << "]";
   return os;
-}
\ No newline at end of file
+}
@@ -1,14 +1,20 @@
-#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
 #include <string>
-#include <utility>
-#include <vector>
+
+#include <boost/utility/string_ref.hpp>
 
 #include "errors.h"
+#include "interner.h"
+#include "source_manager.h"
 
 #ifndef SRC_TOKENS_H_
 #define SRC_TOKENS_H_
 
-enum class TokenKind {
+// the numbers are written by the bin token dump and the token cache, which
+// both record NOT_A_KIND as the number of kinds
+enum class TokenKind : uint8_t {
   IDENTIFIER = 0,
   NUMBER,
   STRING,
@@ -38,6 +44,27 @@ enum class TokenKind {
   KEY_CONST,
   KEY_TYPEDEF,
   KEY_SIZEOF,
+  KEY_SWITCH,
+  KEY_CASE,
+  KEY_DEFAULT,
+  KEY_DO,
+  KEY_GOTO,
+  KEY_ENUM,
+  KEY_FLOAT,
+  KEY_DOUBLE,
+  KEY_VOLATILE,
+  KEY_RESTRICT,
+  KEY_INLINE,
+  KEY_REGISTER,
+  KEY_ALIGNAS,
+  KEY_ALIGNOF,
+  KEY_ATOMIC,
+  KEY_COMPLEX,
+  KEY_GENERIC,
+  KEY_IMAGINARY,
+  KEY_NORETURN,
+  KEY_STATIC_ASSERT,
+  KEY_THREAD_LOCAL,
   // SYMBOL
   SB_ADD,
   SB_MIN,
@@ -78,50 +105,76 @@ enum class TokenKind {
   SB_SEMI,
   SB_DOT,
   SB_ARROW,
+  SB_EQUSAL,
+  SB_EQUSAR,
+  SB_EQUAND,
+  SB_OR,
+  SB_EQUOR,
+  SB_XOR,
+  SB_EQUXOR,
+  SB_ELLIPSIS,
+  SB_QUES,
+  SB_COLON,
   NOT_A_KIND
 };
 
-using TokenPair = std::pair<TokenKind, std::string>;
-
+/*
+ Token representing one token, its text read back from the source or the
+ Interner when asked for
+ kind_ - Kind of the token
+ file_ - File the token is in
+ offset_ - Byte offset of the first byte of the token in its file
+ length_ - Number of source bytes the token spans
+ payload_ - Symbol of an identifier, of the value of a string or char, or
+            of the spelling of another token split by a line splice,
+            no_payload when the source bytes are all there is
+ */
 class Token {
  public:
-  Token(const TokenKind& kind = TokenKind::NOT_A_KIND,
-        const std::string& content = "", const std::string& rep = "",
-        std::shared_ptr<Range> range = std::shared_ptr<Range>(nullptr));
+  Token(TokenKind kind = TokenKind::NOT_A_KIND, FileID file = 0,
+        uint32_t offset = 0, uint32_t length = 0,
+        uint32_t payload = no_payload);
 
  public:
   TokenKind getTokenKind() const;
-  std::string getContent() const;
-  std::string getRep() const;
-  std::shared_ptr<Range> getRange() const;
+  FileID getFileID() const;
+  uint32_t getOffset() const;
+  uint32_t getLength() const;
+  SymbolID getSymbol() const;
+  Range getRange() const;
 
-  static TokenPair findSymbolKind(const std::vector<Tagged>& taggedline,
-                                  size_t start_index);
+  // bytes the token is written as, quotes included for strings, put
+  // together in scratch when a line splice splits a string or char
+  boost::string_ref getSpelling(std::string& scratch) const;
+  // decoded value for strings and chars, the spelling otherwise
+  boost::string_ref getContent() const;
+  // spelling for strings and chars, empty otherwise
+  boost::string_ref getRep(std::string& scratch) const;
 
-  static TokenPair findKeyWordKind(const std::vector<Tagged>& taggedline,
-                                   size_t start_index, size_t end_index);
+  // longest operator or punctuator at begin, its length or 0 if none
+  static size_t matchSymbol(const char* begin, const char* end,
+                            TokenKind& kind);
 
-  static std::string findNumber(const std::vector<Tagged>& taggedline,
-                                size_t start_index, size_t end_index);
+  // keyword spelled by [begin, end), or NOT_A_KIND
+  static TokenKind findKeyWordKind(const char* begin, const char* end);
 
-  static std::string findIdentifier(const std::vector<Tagged>& taggedline,
-                                    size_t start_index, size_t end_index);
+  static bool isNumber(const char* begin, const char* end);
 
-  friend std::ostream& operator<<(std::ostream& os, const Token& ce);
+  static bool isIdentifier(const char* begin, const char* end);
 
- private:
-  void tokenPairInit();
+  friend std::ostream& operator<<(std::ostream& os, const Token& tk);
 
- private:
-  TokenKind kind_;
-  std::string content_;
-  std::string rep_;
-  std::shared_ptr<Range> range_;
+ public:
+  static constexpr uint32_t no_payload = UINT32_MAX;
 
  private:
-  static const std::vector<TokenPair> keyword_kinds_;
-  static const std::vector<TokenPair> symbol_kinds_;
+  TokenKind kind_;
+  FileID file_;
+  uint32_t offset_;
+  uint32_t length_;
+  uint32_t payload_;
 };
 
+const char* TokenKindToStr(TokenKind tk);
 std::ostream& operator<<(std::ostream& os, const Token& tk);
 #endif  // SRC_TOKENS_H_
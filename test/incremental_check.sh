@@ -0,0 +1,30 @@
+#!/bin/sh
+# runs of AYCC -inc on the same files, each checked to compile again only
+# the files whose sources changed since the run before
+#   incremental_check.sh AYCC
+
+aycc=$1
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+
+printf '#include "a.h"\nint a;\n' > a.c
+printf 'int b;\n' > b.c
+printf 'int h;\n' > a.h
+
+# expect UP_TO_DATE: the stats line of a run must say that many were reused
+expect() {
+  if ! "$aycc" -s -inc manifest -f a.c b.c 2>&1 |
+       grep -q "^\[stats\] incremental: $1 of 2 files up to date$"; then
+    echo "$2: expected $1 of 2 files up to date" >&2
+    exit 1
+  fi
+}
+
+expect 0 "first run"
+expect 2 "nothing changed"
+printf 'int h2;\n' >> a.h
+expect 1 "a.h changed"
+touch b.c
+expect 2 "b.c touched, same bytes"
+echo "incremental runs checked"
@@ -0,0 +1,126 @@
+// random edits of a buffer relexed by IncrementalLexer, checked against
+// lexing the whole buffer again, and its lines against counting them
+//   relex_check [edits] [seed]
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "compile_unit.h"
+#include "errors.h"
+#include "incremental_lexer.h"
+#include "lexer.h"
+#include "source_manager.h"
+#include "tokens.h"
+
+// pieces edits are made of, comments, strings and splices among them so an
+// edit changes how the lines after it lex
+static const char* const pieces[] = {
+    "int a = 1;\n", "/* ", " */", "// note\n", "\"text\"", "\"open",
+    "'c'",          "\\\n", "\n",  "x",        "  ",       "#include <a.h>\n",
+    "0x1f",         "@",    "+=",  "}\n",      "{",        "*/\n"};
+
+static std::string makePiece(std::mt19937& random) {
+  size_t count = sizeof(pieces) / sizeof(*pieces);
+  return pieces[random() % count];
+}
+
+static bool sameTokens(FileID file, const IncrementalLexer& relexed,
+                       size_t& errors) {
+  Arena arena;
+  std::vector<CompilerError> found;
+  std::ostream discard(nullptr);
+  CompileUnit unit{arena, found, discard, TokenDump::NONE, 0, nullptr,
+                   nullptr, nullptr, nullptr, 0, 0};
+  Lexer lexer(file, unit);
+  Token token;
+  size_t index = 0;
+  while (lexer.next(token)) {
+    if (index >= relexed.getTokenCount()) {
+      std::fprintf(stderr, "token %zu missing\n", index);
+      return false;
+    }
+    Token other = relexed.getToken(index++);
+    if ((token.getTokenKind() != other.getTokenKind()) ||
+        (token.getOffset() != other.getOffset()) ||
+        (token.getLength() != other.getLength()) ||
+        (token.getSymbol() != other.getSymbol())) {
+      std::fprintf(stderr, "token %zu at %u differs from one at %u\n",
+                   index - 1, token.getOffset(), other.getOffset());
+      return false;
+    }
+  }
+  if (index != relexed.getTokenCount()) {
+    std::fprintf(stderr, "%zu tokens, %zu relexed\n", index,
+                 relexed.getTokenCount());
+    return false;
+  }
+  errors = found.size();
+  return true;
+}
+
+static bool sameLines(FileID file, const std::string& text) {
+  SourceManager& manager = SourceManager::instance();
+  size_t line = 1;
+  for (size_t offset = 0; offset < text.size(); ++offset) {
+    if (manager.getLine(file, static_cast<uint32_t>(offset)) != line) {
+      std::fprintf(stderr, "offset %zu not on line %zu\n", offset, line);
+      return false;
+    }
+    line += (text[offset] == '\n') ? (1) : (0);
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  size_t edits = (argc > 1) ? (std::strtoul(argv[1], nullptr, 10)) : (3000);
+  uint32_t seed = (argc > 2) ? (std::strtoul(argv[2], nullptr, 10)) : (1);
+  std::mt19937 random(seed);
+
+  std::string text;
+  for (size_t index = 0; index < 200; ++index) {
+    text += makePiece(random);
+  }
+  FileID file;
+  if (!SourceManager::instance().addBuffer("relex_check.c", text, file)) {
+    std::fprintf(stderr, "can't add the buffer\n");
+    return 1;
+  }
+  IncrementalLexer relexed(file);
+  size_t relexed_lines = 0;
+
+  for (size_t edit = 1; edit <= edits; ++edit) {
+    uint32_t offset = static_cast<uint32_t>(random() % (text.size() + 1));
+    uint32_t length = static_cast<uint32_t>(
+        std::min<size_t>(random() % 6, text.size() - offset));
+    std::string piece = (random() % 4 == 0) ? ("") : (makePiece(random));
+    if (!relexed.edit(offset, length, piece)) {
+      std::fprintf(stderr, "edit %zu refused\n", edit);
+      return 1;
+    }
+    text.replace(offset, length, piece);
+    relexed_lines += relexed.getRelexedLines();
+
+    // a few edits in a row leave the gap where they were
+    if ((edit % 7 != 0) && (edit != edits)) {
+      continue;
+    }
+    const SourceBuffer& buffer = SourceManager::instance().getBuffer(file);
+    size_t errors = 0;
+    if ((std::string(buffer.begin(), buffer.end()) != text) ||
+        (!sameTokens(file, relexed, errors)) ||
+        (errors != relexed.getErrors().size()) || (!sameLines(file, text))) {
+      std::fprintf(stderr, "edit %zu (seed %u) relexed wrong\n", edit, seed);
+      return 1;
+    }
+  }
+
+  std::printf("%zu edits of a %zu byte buffer, %zu lines relexed\n", edits,
+              text.size(), relexed_lines);
+  return 0;
+}
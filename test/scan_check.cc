@@ -0,0 +1,105 @@
+// random buffers scanned by every kernel the CPU has, checked against the
+// scalar one. "*/" is put across the 16 and 32 byte boundaries and '*' at
+// the last byte, where a vector kernel has to look at the next block
+//   scan_check [rounds] [seed]
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "scan.h"
+
+// bytes the scanners stop at, and some they must step over
+static const char scanned[] = {' ', '\t', '*', '/', '\n', '"', '\'', '\\',
+                               'a', '0', '\x80', '\xe9', '\xff', '\0'};
+
+static std::string makeBuffer(std::mt19937& random) {
+  size_t size = random() % 100;
+  // one in rare of the bytes is any of scanned, the rest blanks and letters.
+  // with few of them the kernels run to the blocks at the end
+  size_t rare = (random() % 3 == 0) ? (2) : (64);
+  std::string buffer;
+  for (size_t index = 0; index < size; ++index) {
+    if (random() % rare == 0) {
+      buffer += scanned[random() % sizeof(scanned)];
+    } else {
+      buffer += (random() % 2 == 0) ? (' ') : ('a');
+    }
+  }
+
+  switch (random() % 4) {
+    case 0:
+      buffer.replace(std::min<size_t>(15, buffer.size()), 2, "*/");
+      break;
+    case 1:
+      buffer.replace(std::min<size_t>(31, buffer.size()), 2, "*/");
+      break;
+    case 2:
+      buffer += '*';
+      break;
+    default:
+      break;
+  }
+  return buffer;
+}
+
+// offsets found by the kernels in use for [begin, end) of buffer
+static std::vector<size_t> scan(const std::vector<char>& buffer, size_t begin,
+                                size_t end) {
+  const char* first = buffer.data() + begin;
+  const char* last = buffer.data() + end;
+  std::vector<size_t> found;
+  found.push_back(skipBlanks(first, last) - first);
+  found.push_back(findCommentEnd(first, last) - first);
+  found.push_back(findStringSpecial(first, last, '"') - first);
+  found.push_back(findStringSpecial(first, last, '\'') - first);
+  return found;
+}
+
+int main(int argc, char** argv) {
+  size_t rounds = (argc > 1) ? (std::strtoul(argv[1], nullptr, 10)) : (20000);
+  uint32_t seed = (argc > 2) ? (std::strtoul(argv[2], nullptr, 10)) : (1);
+  std::mt19937 random(seed);
+
+  std::vector<const char*> kernels;
+  for (const char* name : {"avx2", "sse2"}) {
+    if (useScanKernels(name)) {
+      kernels.push_back(name);
+    }
+  }
+
+  for (size_t round = 1; round <= rounds; ++round) {
+    std::string text = makeBuffer(random);
+    // a '/' after the end makes a '*' ending the buffer look like "*/" to
+    // a kernel reading past it
+    std::vector<char> buffer(text.begin(), text.end());
+    buffer.push_back('/');
+    size_t begin = random() % (text.size() / 4 + 1);
+    size_t end = text.size();
+    if (random() % 4 == 0) {
+      end = begin + random() % (end - begin + 1);
+    }
+
+    useScanKernels("scalar");
+    std::vector<size_t> expected = scan(buffer, begin, end);
+    for (const char* name : kernels) {
+      useScanKernels(name);
+      if (scan(buffer, begin, end) != expected) {
+        std::fprintf(stderr, "round %zu (seed %u): %s differs from scalar\n",
+                     round, seed, name);
+        return 1;
+      }
+    }
+  }
+
+  std::printf("%zu buffers scanned by scalar", rounds);
+  for (const char* name : kernels) {
+    std::printf(", %s", name);
+  }
+  std::printf("\n");
+  return 0;
+}
@@ -0,0 +1,140 @@
+// a header stored in a TokenCache and loaded again, checked against the
+// entry stored, and files the cache must not serve: written by another
+// lexer version, or including a file shadowed or removed since
+//   token_cache_check
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "arena.h"
+#include "compile_unit.h"
+#include "errors.h"
+#include "header_search.h"
+#include "include_cache.h"
+#include "lexer.h"
+#include "preproc.h"
+#include "source_manager.h"
+#include "token_cache.h"
+#include "tokens.h"
+
+namespace bf = boost::filesystem;
+
+static void writeFile(const bf::path& path, const std::string& text) {
+  std::ofstream out(path.string(), std::ios::binary | std::ios::trunc);
+  out << text;
+}
+
+static bool sameToken(const Token& left, const Token& right) {
+  return (left.getTokenKind() == right.getTokenKind()) &&
+         (left.getFileID() == right.getFileID()) &&
+         (left.getOffset() == right.getOffset()) &&
+         (left.getLength() == right.getLength()) &&
+         (left.getSymbol() == right.getSymbol());
+}
+
+static bool sameEntry(const IncludeCache::Entry& left,
+                      const IncludeCache::Entry& right) {
+  if ((left.tokens_.size() != right.tokens_.size()) ||
+      (left.includes_.size() != right.includes_.size()) ||
+      (left.guard_.isOnce() != right.guard_.isOnce()) ||
+      (left.guard_.getMacro() != right.guard_.getMacro()) ||
+      (left.out_ != right.out_)) {
+    return false;
+  }
+  for (size_t index = 0; index < left.tokens_.size(); ++index) {
+    if (!sameToken(left.tokens_[index], right.tokens_[index])) {
+      return false;
+    }
+  }
+  for (size_t index = 0; index < left.includes_.size(); ++index) {
+    const IncludeCache::Include& one = left.includes_[index];
+    const IncludeCache::Include& other = right.includes_[index];
+    if ((one.token_ != other.token_) || (one.out_ != other.out_) ||
+        (one.file_ != other.file_) ||
+        (!sameToken(one.filename_, other.filename_))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// a.h loaded from cache into a new entry, false if the cache had none
+static bool load(const TokenCache& cache, FileID file,
+                 const CompileUnit& unit, IncludeCache::Entry& entry) {
+  HeaderSearch::instance().forgetLookups();
+  return cache.load(file, unit, entry);
+}
+
+static int fail(const char* what) {
+  std::fprintf(stderr, "%s\n", what);
+  return 1;
+}
+
+int main() {
+  bf::path dir = bf::temp_directory_path() /
+                 bf::unique_path("token_cache_check-%%%%-%%%%");
+  bf::create_directories(dir / "inc");
+  writeFile(dir / "a.h",
+            "#ifndef A_H\n#define A_H\n#include \"c.h\"\n"
+            "int a = 1; /* x */ char* s = \"a\\n\";\n#endif\n");
+  writeFile(dir / "inc" / "c.h", "int c;\n");
+
+  Arena arena;
+  std::vector<CompilerError> errors;
+  std::ostream discard(nullptr);
+  SearchID search = HeaderSearch::instance().addSearchList(
+      {(dir / "inc").string()}, {});
+  CompileUnit unit{arena, errors, discard, TokenDump::NONE, 0, nullptr,
+                   nullptr, nullptr, nullptr, search, 0};
+  FileID file;
+  if (!SourceManager::instance().loadFile((dir / "a.h").string(), file)) {
+    return fail("can't load a.h");
+  }
+
+  IncludeCache::Entry lexed(file, 4096, 0, 0);
+  PreProc::lexHeader(file, unit, lexed);
+  if ((!lexed.errors_.empty()) || (lexed.includes_.size() != 1) ||
+      (!lexed.guard_.isOnce())) {
+    return fail("a.h lexed wrong");
+  }
+  TokenCache cache((dir / "cache").string());
+  cache.store(file, unit, lexed);
+
+  int result = 0;
+  IncludeCache::Entry loaded(file, 4096, 0, 0);
+  if ((!load(cache, file, unit, loaded)) || (!sameEntry(lexed, loaded))) {
+    result = fail("a.h loaded differs from a.h stored");
+  }
+
+  IncludeCache::Entry other_version(file, 4096, 0, 0);
+  TokenCache newer((dir / "cache").string(), Lexer::version + 1);
+  if (load(newer, file, unit, other_version)) {
+    result = fail("a.h loaded by another lexer version");
+  }
+
+  // found next to a.h before the search list now
+  writeFile(dir / "c.h", "int shadow;\n");
+  IncludeCache::Entry shadowed(file, 4096, 0, 0);
+  if (load(cache, file, unit, shadowed)) {
+    result = fail("a.h loaded with its include shadowed");
+  }
+
+  bf::remove(dir / "c.h");
+  bf::remove(dir / "inc" / "c.h");
+  IncludeCache::Entry removed(file, 4096, 0, 0);
+  if (load(cache, file, unit, removed)) {
+    result = fail("a.h loaded with its include removed");
+  }
+
+  bf::remove_all(dir);
+  if (result == 0) {
+    std::printf("round trip and 3 invalidations checked\n");
+  }
+  return result;
+}